@@ -1,4 +1,4 @@
-QT       += core gui pdf
+QT       += core gui pdf concurrent network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,24 +9,69 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    src/annotationlayer.cpp \
     src/breadcrumbswidget.cpp \
+    src/commandserver.cpp \
+    src/compositescene.cpp \
     src/drawcurve.cpp \
     src/gidfile.cpp \
     src/graphicsview.cpp \
+    src/imagefilters.cpp \
     src/main.cpp \
     src/mainwindow.cpp \
-    src/pagescene.cpp
+    src/mappedfile.cpp \
+    src/memorygovernor.cpp \
+    src/page.cpp \
+    src/pageimage.cpp \
+    src/pagescene.cpp \
+    src/pdfregistry.cpp \
+    src/renderscheduler.cpp \
+    src/scenepool.cpp \
+    src/sessionreader.cpp \
+    src/sessionwriter.cpp \
+    src/startupsnapshot.cpp \
+    src/startuptimeline.cpp \
+    src/synclink.cpp \
+    src/thumbnailcache.cpp \
+    src/thumbnailswidget.cpp \
+    src/undostack.cpp
 
 HEADERS += \
+    src/annotationlayer.h \
     src/breadcrumbswidget.h \
+    src/commandserver.h \
+    src/compositescene.h \
     src/drawcurve.h \
     src/gidfile.h \
     src/graphicsview.h \
+    src/imagefilters.h \
     src/mainwindow.h \
+    src/mappedfile.h \
+    src/memorygovernor.h \
+    src/page.h \
+    src/pageimage.h \
     src/pagescene.h \
+    src/pdfregistry.h \
+    src/renderscheduler.h \
+    src/scenepool.h \
+    src/sessionreader.h \
+    src/sessionwriter.h \
     src/settings.h \
+    src/startupsnapshot.h \
+    src/startuptimeline.h \
+    src/synclink.h \
+    src/thumbnailcache.h \
+    src/thumbnailswidget.h \
+    src/undostack.h \
     src/version.h
 
+# ALSA MIDI input for external page turn commands, if available
+unix:!android:packagesExist(alsa) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += alsa
+    DEFINES += SHEEPMUSIC_ALSA
+}
+
 FORMS += \
     src/mainwindow.ui
 
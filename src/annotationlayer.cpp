@@ -0,0 +1,104 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "annotationlayer.h"
+
+#include <QPainter>
+#include <QtMath>
+
+AnnotationLayer::AnnotationLayer(QGraphicsItem* parent)
+    : QGraphicsItem(parent)
+{
+
+}
+
+void AnnotationLayer::setCurves(QList<DrawCurvePtr> curves, AnnotationCachePtr cache)
+{
+    prepareGeometryChange();
+
+    mCurves = curves;
+    if (!cache) {
+        cache.reset(new AnnotationCache());
+    }
+    mCache = cache;
+    if (mCache->curves != mCurves) {
+        mCache->curves = mCurves;
+        mCache->pixmaps.clear();
+    }
+
+    mBounds = QRectF();
+    foreach (DrawCurvePtr curve, mCurves) {
+        mBounds = mBounds.united(curve->painterPath().boundingRect());
+    }
+    if (!mCurves.isEmpty()) {
+        mBounds.adjust(-margin, -margin, margin, margin);
+    }
+
+    update();
+}
+
+QRectF AnnotationLayer::boundingRect() const
+{
+    return mBounds;
+}
+
+void AnnotationLayer::paint(QPainter* painter,
+                            const QStyleOptionGraphicsItem* /*option*/,
+                            QWidget* /*widget*/)
+{
+    if (mCurves.isEmpty()) { return; }
+
+    // Device pixels per scene unit
+    QTransform t = painter->deviceTransform();
+    qreal scale = qSqrt(t.m11() * t.m11() + t.m12() * t.m12());
+    if (scale <= 0) { return; }
+
+    QSize size(qCeil(mBounds.width() * scale), qCeil(mBounds.height() * scale));
+    if ((qint64)size.width() * size.height() > maxCachedPixels) {
+        paintCurves(painter);
+        return;
+    }
+
+    qint64 key = qRound64(scale * 1000);
+    QPixmap pixmap = mCache->pixmaps.value(key);
+    if (pixmap.isNull()) {
+        pixmap = QPixmap(size);
+        pixmap.fill(Qt::transparent);
+        QPainter p(&pixmap);
+        p.scale(scale, scale);
+        p.translate(-mBounds.topLeft());
+        paintCurves(&p);
+
+        if (mCache->pixmaps.count() >= maxCachedScales) { mCache->pixmaps.clear(); }
+        mCache->pixmaps.insert(key, pixmap);
+    }
+
+    painter->drawPixmap(QRectF(mBounds.topLeft(), QSizeF(size) / scale),
+                        pixmap, QRectF(pixmap.rect()));
+}
+
+void AnnotationLayer::paintCurves(QPainter* painter)
+{
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setPen(DrawCurve::pen());
+    foreach (DrawCurvePtr curve, mCurves) {
+        painter->drawPath(curve->painterPath());
+    }
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef ANNOTATIONLAYER_H
+#define ANNOTATIONLAYER_H
+
+#include "drawcurve.h"
+
+#include <QGraphicsItem>
+#include <QMap>
+#include <QPixmap>
+#include <QSharedPointer>
+
+// Rasterised curves of a page. Kept with the page (Page::annotationCache()) so
+// they are reused when a pooled scene is bound to the page again.
+struct AnnotationCache
+{
+    // Curves the pixmaps were rasterised from
+    QList<DrawCurvePtr> curves;
+    // Per device scale (x1000)
+    QMap<qint64, QPixmap> pixmaps;
+};
+
+typedef QSharedPointer<AnnotationCache> AnnotationCachePtr;
+
+// Graphics item painting a set of finished draw curves from a cached pixmap.
+// The curves are rasterised once per view scale and the pixmap is reused until
+// the curves change, so the number of curves doesn't affect repaints and the
+// scene only has one item for all of them.
+class AnnotationLayer : public QGraphicsItem
+{
+public:
+    AnnotationLayer(QGraphicsItem* parent = nullptr);
+
+    // Without a cache, the layer uses its own
+    void setCurves(QList<DrawCurvePtr> curves,
+                   AnnotationCachePtr cache = AnnotationCachePtr());
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
+               QWidget* widget) override;
+
+private:
+    QList<DrawCurvePtr> mCurves;
+    QRectF mBounds;
+
+    // Usually only the fit-to-view and zoomed scales are in use, so only a few
+    // are kept.
+    AnnotationCachePtr mCache;
+    const int maxCachedScales = 3;
+    // Larger rasterisations (when zoomed in far) are not cached, the curves
+    // are painted directly instead.
+    const qint64 maxCachedPixels = 16 * 1024 * 1024;
+    // Margin around curves for the pen width, in scene units
+    const qreal margin = 10;
+
+    void paintCurves(QPainter* painter);
+};
+
+#endif // ANNOTATIONLAYER_H
@@ -22,41 +22,154 @@
 
 #include <QPainter>
 #include <QMouseEvent>
+#include <QToolTip>
+#include <QtMath>
+
+static const QColor currentColor("#2f8ca3");
+static const QColor scrubColor("#f5a623");
 
 BreadcrumbsWidget::BreadcrumbsWidget(QWidget *parent)
     : QWidget{parent}
 {
-
+    setMouseTracking(true);
 }
 
 void BreadcrumbsWidget::setBounds(int count, int current)
 {
-    mCount = count;
-    mCurrent = current;
+    if ((count == mCount) && (current == mCurrent)) { return; }
 
-    update();
+    if (count != mCount) {
+        mCount = count;
+        mCurrent = current;
+        mBackgroundDirty = true;
+        update();
+    } else {
+        // Only the old and new current items need to be repainted
+        update(itemRect(mCurrent).adjusted(-1, -1, 1, 1));
+        mCurrent = current;
+        update(itemRect(mCurrent).adjusted(-1, -1, 1, 1));
+    }
 }
 
-void BreadcrumbsWidget::paintEvent(QPaintEvent* /*event*/)
+void BreadcrumbsWidget::setScrubEnabled(bool enabled)
 {
-    QPainter painter(this);
+    mScrubEnabled = enabled;
+    if (!enabled && mScrubbing) {
+        mScrubbing = false;
+        update();
+    }
+}
+
+void BreadcrumbsWidget::updateBackground()
+{
+    qreal dpr = devicePixelRatioF();
+    mBackground = QPixmap(size() * dpr);
+    mBackground.setDevicePixelRatio(dpr);
+    mBackground.fill(Qt::transparent);
 
-    QBrush bg(Qt::white);
-    QBrush current(QColor("#2f8ca3"));
+    QPainter painter(&mBackground);
 
     if (mCount <= 0) {
         painter.drawRect(this->rect());
     } else {
         float w = (float)width() / (float)mCount;
-        for (int i = 0; i < mCount; i++) {
-            if (i == mCurrent) {
-                painter.setBrush(current);
-            } else {
-                painter.setBrush(bg);
+        if (w >= minItemWidthForBorders) {
+            painter.setBrush(Qt::white);
+            for (int i = 0; i < mCount; i++) {
+                painter.drawRect(w * i, 0, w, height());
+            }
+        } else {
+            // Items are merged into pixel-width buckets. Only draw item borders
+            // every so many items so they stay distinguishable.
+            painter.setBrush(Qt::white);
+            painter.drawRect(this->rect());
+            int stride = qCeil(minItemWidthForBorders / w);
+            painter.setPen(Qt::lightGray);
+            for (int i = stride; i < mCount; i += stride) {
+                painter.drawLine(QPointF(w * i, 1), QPointF(w * i, height() - 1));
             }
-            painter.drawRect(w * i, 0, w, height());
         }
     }
+
+    mBackgroundDirty = false;
+}
+
+QRect BreadcrumbsWidget::itemRect(int index)
+{
+    if (mCount <= 0) { return QRect(); }
+
+    float w = (float)width() / (float)mCount;
+    QRectF rect(w * index, 0, w, height());
+    if (rect.width() < minHighlightWidth) {
+        QPointF center = rect.center();
+        rect.setWidth(minHighlightWidth);
+        rect.moveCenter(center);
+    }
+    return rect.toAlignedRect();
+}
+
+int BreadcrumbsWidget::scrubItemCount()
+{
+    return qMax(1, width() / scrubItemWidth);
+}
+
+int BreadcrumbsWidget::scrubIndexAt(int x)
+{
+    int index = mScrubStart + x / scrubItemWidth;
+    return qBound(0, index, mCount - 1);
+}
+
+bool BreadcrumbsWidget::scrubNeeded()
+{
+    if (!mScrubEnabled || (mCount <= 0)) { return false; }
+    return ((float)width() / (float)mCount) < (scrubItemWidth / 2);
+}
+
+void BreadcrumbsWidget::paintScrub(QPainter& painter)
+{
+    painter.fillRect(this->rect(), Qt::white);
+
+    int n = scrubItemCount();
+    for (int i = 0; i < n; i++) {
+        int index = mScrubStart + i;
+        if (index >= mCount) { break; }
+
+        QRect rect(i * scrubItemWidth, 0, scrubItemWidth, height());
+        if (index == mScrubIndex) {
+            painter.setBrush(scrubColor);
+        } else if (index == mCurrent) {
+            painter.setBrush(currentColor);
+        } else {
+            painter.setBrush(Qt::white);
+        }
+        painter.drawRect(rect);
+        painter.drawText(rect, Qt::AlignCenter, QString::number(index + 1));
+    }
+}
+
+void BreadcrumbsWidget::paintEvent(QPaintEvent* /*event*/)
+{
+    QPainter painter(this);
+
+    if (mScrubbing) {
+        paintScrub(painter);
+        return;
+    }
+
+    // Painting is clipped to the update region, so when only the current item
+    // changed, only that part of the background is blitted.
+    if (mBackgroundDirty) { updateBackground(); }
+    painter.drawPixmap(0, 0, mBackground);
+
+    if ((mCurrent >= 0) && (mCurrent < mCount)) {
+        painter.setBrush(currentColor);
+        painter.drawRect(itemRect(mCurrent));
+    }
+}
+
+void BreadcrumbsWidget::resizeEvent(QResizeEvent* /*event*/)
+{
+    mBackgroundDirty = true;
 }
 
 void BreadcrumbsWidget::mousePressEvent(QMouseEvent* event)
@@ -64,5 +177,46 @@ void BreadcrumbsWidget::mousePressEvent(QMouseEvent* event)
     if (mCount <= 0) { return; }
 
     int index = ((float)event->pos().x() / (float)width()) * mCount;
-    emit breadcrumbClicked(index);
+
+    if (scrubNeeded()) {
+        // Start magnified scrub around the pressed item. Index is emitted on
+        // release.
+        int n = scrubItemCount();
+        mScrubStart = qBound(0, index - n/2, qMax(0, mCount - n));
+        mScrubIndex = qBound(0, index, mCount - 1);
+        mScrubbing = true;
+        update();
+    } else {
+        emit breadcrumbClicked(index);
+    }
+}
+
+void BreadcrumbsWidget::mouseMoveEvent(QMouseEvent* event)
+{
+    int x = event->pos().x();
+
+    if (mScrubbing) {
+        // Pan the magnified view when dragging at its edges
+        int n = scrubItemCount();
+        if ((x < scrubItemWidth / 2) && (mScrubStart > 0)) {
+            mScrubStart--;
+        } else if ((x > width() - scrubItemWidth / 2) && (mScrubStart < mCount - n)) {
+            mScrubStart++;
+        }
+        mScrubIndex = scrubIndexAt(x);
+        update();
+    } else if ((event->buttons() == Qt::NoButton) && scrubNeeded()) {
+        int index = ((float)x / (float)width()) * mCount;
+        QToolTip::showText(event->globalPos(),
+                           QString("%1 / %2").arg(index + 1).arg(mCount), this);
+    }
+}
+
+void BreadcrumbsWidget::mouseReleaseEvent(QMouseEvent* /*event*/)
+{
+    if (!mScrubbing) { return; }
+
+    mScrubbing = false;
+    update();
+    emit breadcrumbClicked(mScrubIndex);
 }
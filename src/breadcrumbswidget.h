@@ -21,6 +21,7 @@
 #ifndef BREADCRUMBSWIDGET_H
 #define BREADCRUMBSWIDGET_H
 
+#include <QPixmap>
 #include <QWidget>
 
 class BreadcrumbsWidget : public QWidget
@@ -31,6 +32,10 @@ public:
 
     void setBounds(int count, int current);
 
+    // When items are too narrow to be hit accurately, pressing and dragging
+    // shows a magnified scrub view of the items around the pointer.
+    void setScrubEnabled(bool enabled);
+
 signals:
     void breadcrumbClicked(int index);
 
@@ -38,8 +43,35 @@ private:
     int mCount = 0;
     int mCurrent = 0;
 
+    // Item borders are only drawn when items are at least this wide (pixels).
+    // Narrower items are merged into pixel-width buckets.
+    const int minItemWidthForBorders = 3;
+    // Minimum width of the current item highlight (pixels)
+    const int minHighlightWidth = 3;
+
+    // Background (all items excluding current) is cached and only redrawn when
+    // the size or item count changes.
+    QPixmap mBackground;
+    bool mBackgroundDirty = true;
+    void updateBackground();
+    QRect itemRect(int index);
+
+    bool mScrubEnabled = true;
+    bool mScrubbing = false;
+    int mScrubIndex = 0;
+    int mScrubStart = 0;
+    // Width of items in the magnified scrub view (pixels)
+    const int scrubItemWidth = 32;
+    int scrubItemCount();
+    int scrubIndexAt(int x);
+    bool scrubNeeded();
+    void paintScrub(QPainter& painter);
+
     void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
     void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
 };
 
 #endif // BREADCRUMBSWIDGET_H
@@ -0,0 +1,272 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "commandserver.h"
+#include "version.h"
+
+#include <QSocketNotifier>
+
+#ifdef SHEEPMUSIC_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+const QString CommandServer::defaultServerName = "sheepmusic";
+
+// Time to wait for a running instance when checking whether a name is in use
+static const int probeTimeoutMs = 500;
+
+CommandServer::CommandServer(QObject* parent)
+    : QObject{parent}
+{
+    mClock.start();
+
+    mServer.setSocketOptions(QLocalServer::UserAccessOption);
+    connect(&mServer, &QLocalServer::newConnection,
+            this, &CommandServer::onNewConnection);
+}
+
+CommandServer::~CommandServer()
+{
+#ifdef SHEEPMUSIC_ALSA
+    if (mSeq) {
+        snd_seq_close(mSeq);
+    }
+#endif
+}
+
+void CommandServer::setHandler(Handler handler)
+{
+    mHandler = handler;
+}
+
+QString CommandServer::handle(Command command)
+{
+    if (!mHandler) { return "not ready"; }
+    return mHandler(command);
+}
+
+bool CommandServer::listen(QString name)
+{
+    // Don't take over the name of a running instance. Only remove the socket
+    // of an instance that did not exit cleanly (connection refused).
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(probeTimeoutMs)) {
+        mErrorString = QString("Name %1 is in use by another instance").arg(name);
+        return false;
+    }
+    if (probe.error() == QLocalSocket::ConnectionRefusedError) {
+        QLocalServer::removeServer(name);
+    }
+
+    if (!mServer.listen(name)) {
+        mErrorString = mServer.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool CommandServer::startMidi()
+{
+#ifdef SHEEPMUSIC_ALSA
+    if (snd_seq_open(&mSeq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK) < 0) {
+        mSeq = nullptr;
+        mErrorString = "Could not open ALSA sequencer";
+        return false;
+    }
+    snd_seq_set_client_name(mSeq, APP_NAME);
+
+    int port = snd_seq_create_simple_port(mSeq, "Page turn",
+            SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+            SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+    if (port < 0) {
+        mErrorString = "Could not create ALSA sequencer port";
+        return false;
+    }
+
+    int count = snd_seq_poll_descriptors_count(mSeq, POLLIN);
+    QVector<pollfd> fds(count);
+    snd_seq_poll_descriptors(mSeq, fds.data(), count, POLLIN);
+    foreach (const pollfd& fd, fds) {
+        QSocketNotifier* notifier = new QSocketNotifier(fd.fd, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated, this, &CommandServer::readMidi);
+    }
+    return true;
+#else
+    mErrorString = "Built without ALSA MIDI support";
+    return false;
+#endif
+}
+
+QString CommandServer::errorString()
+{
+    return mErrorString;
+}
+
+qint64 CommandServer::elapsedNs()
+{
+    return mClock.nsecsElapsed();
+}
+
+QString CommandServer::send(QString name, QString command, int timeoutMs)
+{
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    if (!socket.waitForConnected(timeoutMs)) {
+        return "error: " + socket.errorString();
+    }
+    socket.write(command.toUtf8() + "\n");
+    socket.waitForBytesWritten(timeoutMs);
+
+    while (!socket.canReadLine()) {
+        if (!socket.waitForReadyRead(timeoutMs)) {
+            return "error: no reply";
+        }
+    }
+    return QString::fromUtf8(socket.readLine()).trimmed();
+}
+
+void CommandServer::onNewConnection()
+{
+    while (QLocalSocket* socket = mServer.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [=]()
+        {
+            readSocket(socket);
+        });
+        connect(socket, &QLocalSocket::disconnected,
+                socket, &QLocalSocket::deleteLater);
+        // Data may have arrived with the connection
+        readSocket(socket);
+    }
+}
+
+void CommandServer::readSocket(QLocalSocket* socket)
+{
+    while (socket->canReadLine()) {
+        qint64 received = elapsedNs();
+        QString line = QString::fromUtf8(socket->readLine()).trimmed();
+        if (line.isEmpty()) { continue; }
+
+        Command command;
+        QString error;
+        if (parseLine(line, &command, &error)) {
+            command.receivedNs = received;
+            command.source = "socket: " + line;
+            error = handle(command);
+        }
+        if (error.isEmpty()) {
+            socket->write("ok\n");
+        } else {
+            socket->write(QString("error: %1\n").arg(error).toUtf8());
+        }
+    }
+}
+
+bool CommandServer::parseLine(QString line, Command* command, QString* error)
+{
+    QStringList words = line.simplified().split(" ");
+    QString name = words.value(0).toLower();
+
+    QList<int> numbers;
+    for (int i = 1; i < words.count(); i++) {
+        bool ok = false;
+        int n = words[i].toInt(&ok);
+        if (!ok || (n < 1)) {
+            *error = "invalid number: " + words[i];
+            return false;
+        }
+        numbers.append(n - 1);
+    }
+
+    if ((name == "next") && numbers.isEmpty()) {
+        command->type = Command::Type::Next;
+    } else if (((name == "prev") || (name == "previous")) && numbers.isEmpty()) {
+        command->type = Command::Type::Previous;
+    } else if ((name == "page") && (numbers.count() == 1)) {
+        command->type = Command::Type::Page;
+        command->page = numbers[0];
+    } else if ((name == "doc") && (numbers.count() >= 1) && (numbers.count() <= 2)) {
+        command->type = Command::Type::Document;
+        command->doc = numbers[0];
+        command->page = numbers.value(1, 0);
+    } else {
+        *error = "unknown command: " + line;
+        return false;
+    }
+    return true;
+}
+
+void CommandServer::readMidi()
+{
+#ifdef SHEEPMUSIC_ALSA
+    snd_seq_event_t* ev = nullptr;
+    while ((snd_seq_event_input(mSeq, &ev) >= 0) && ev) {
+        qint64 received = elapsedNs();
+
+        Command command;
+        bool valid = false;
+        switch (ev->type) {
+        case SND_SEQ_EVENT_NOTEON:
+            if (ev->data.note.velocity == 0) { break; } // Note off
+            if (ev->data.note.note == 62) {
+                command.type = Command::Type::Next;
+                valid = true;
+            } else if (ev->data.note.note == 60) {
+                command.type = Command::Type::Previous;
+                valid = true;
+            }
+            command.source = QString("MIDI note %1").arg(ev->data.note.note);
+            break;
+        case SND_SEQ_EVENT_CONTROLLER: {
+            // Pedal going down only
+            int key = ev->data.control.channel * 128 + (int)ev->data.control.param;
+            if (ev->data.control.value < 64) {
+                mPressedControllers.remove(key);
+                break;
+            }
+            if (mPressedControllers.contains(key)) { break; }
+            mPressedControllers.insert(key);
+            if (ev->data.control.param == 64) {
+                command.type = Command::Type::Next;
+                valid = true;
+            } else if (ev->data.control.param == 67) {
+                command.type = Command::Type::Previous;
+                valid = true;
+            }
+            command.source = QString("MIDI CC %1").arg(ev->data.control.param);
+            break;
+        }
+        case SND_SEQ_EVENT_PGMCHANGE:
+            command.type = Command::Type::Document;
+            command.doc = ev->data.control.value;
+            command.source = QString("MIDI program %1").arg(ev->data.control.value);
+            valid = true;
+            break;
+        default:
+            break;
+        }
+
+        if (valid) {
+            command.receivedNs = received;
+            handle(command);
+        }
+    }
+#endif
+}
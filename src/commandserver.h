@@ -0,0 +1,118 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* CommandServer
+ *
+ * External page turn input, e.g. from foot pedals or a cue machine.
+ *
+ * Commands are received as text lines on a local socket (QLocalServer):
+ *
+ *     next             Next page
+ *     prev             Previous page
+ *     page <p>         Page p of the current document
+ *     doc <d> [<p>]    Document d (page p, default 1)
+ *
+ * Numbers are 1-based. Each command is answered with "ok" once it has been
+ * carried out, or "error: <msg>" if it could not be parsed or the handler
+ * rejected it (e.g. a document or page that doesn't exist).
+ *
+ * When built with ALSA (see sheepmusic.pro), a MIDI sequencer input port is
+ * also created. MIDI messages are mapped as follows:
+ *
+ *     Note on 62, CC 64 (value >= 64)    Next page
+ *     Note on 60, CC 67 (value >= 64)    Previous page
+ *     Program change <n>                 Document n + 1
+ *
+ * Both inputs are read with socket notifiers in the GUI thread and commands
+ * are passed to the handler (setHandler()) directly as they are parsed, so they are handled even while a
+ * dialog's event loop is running. Each command carries the time it was
+ * received (elapsedNs()) so the dispatch latency can be measured.
+ */
+
+#ifndef COMMANDSERVER_H
+#define COMMANDSERVER_H
+
+#include <QElapsedTimer>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QSet>
+
+#include <functional>
+
+#ifdef SHEEPMUSIC_ALSA
+typedef struct _snd_seq snd_seq_t;
+#endif
+
+class CommandServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CommandServer(QObject* parent = nullptr);
+    ~CommandServer();
+
+    static const QString defaultServerName;
+
+    struct Command {
+        enum class Type { Next, Previous, Page, Document } type = Type::Next;
+        // Zero-based document and page
+        int doc = 0;
+        int page = 0;
+        // Time received, see elapsedNs()
+        qint64 receivedNs = 0;
+        QString source;
+    };
+
+    // Carries out a command. Returns an error message, or an empty string on
+    // success.
+    typedef std::function<QString(Command)> Handler;
+    void setHandler(Handler handler);
+
+    bool listen(QString name);
+    bool startMidi();
+    QString errorString();
+    qint64 elapsedNs();
+
+    // Send a command to a running instance. Returns the reply.
+    static QString send(QString name, QString command, int timeoutMs = 1000);
+
+private:
+    Handler mHandler;
+    QString handle(Command command);
+
+    QElapsedTimer mClock;
+    QString mErrorString;
+
+    QLocalServer mServer;
+    void onNewConnection();
+    void readSocket(QLocalSocket* socket);
+    bool parseLine(QString line, Command* command, QString* error);
+
+#ifdef SHEEPMUSIC_ALSA
+    snd_seq_t* mSeq = nullptr;
+#endif
+    // Pedals send a stream of values while moving, so a pedal only turns a
+    // page when it goes from released (< 64) to pressed. Keyed by channel and
+    // controller number.
+    QSet<int> mPressedControllers;
+    void readMidi();
+};
+
+#endif // COMMANDSERVER_H
@@ -0,0 +1,175 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "compositescene.h"
+
+#include <QGraphicsPixmapItem>
+
+CompositeScene::CompositeScene()
+{
+    setBackgroundBrush(QBrush(Qt::gray));
+}
+
+CompositeScene::~CompositeScene()
+{
+    clearPages();
+}
+
+void CompositeScene::setPages(QList<PagePtr> pages, Layout layout)
+{
+    clearPages();
+
+    qreal maxWidth = 0;
+    foreach (PagePtr page, pages) {
+        maxWidth = qMax(maxWidth, page->getPageRect().width());
+    }
+
+    QPointF pos(0, 0);
+    foreach (PagePtr page, pages) {
+        QRectF pageRect = page->getPageRect();
+
+        Item item;
+        item.page = page;
+        item.image = page->pageImage();
+
+        // The frame clips the page to its page (crop) rectangle
+        item.frame = new QGraphicsRectItem(QRectF(QPointF(0, 0), pageRect.size()));
+        item.frame->setBrush(Qt::white);
+        item.frame->setPen(Qt::NoPen);
+        item.frame->setFlag(QGraphicsItem::ItemClipsChildrenToShape);
+        if (layout == Layout::Vertical) {
+            item.frame->setPos(pos.x() + (maxWidth - pageRect.width()) / 2, pos.y());
+            pos.ry() += pageRect.height() + gap;
+        } else {
+            item.frame->setPos(pos);
+            pos.rx() += pageRect.width() + gap;
+        }
+        addItem(item.frame);
+
+        item.pixmap = new QGraphicsPixmapItem(item.frame);
+        item.pixmap->setPos(-pageRect.topLeft());
+
+        AnnotationLayer* annotations = new AnnotationLayer(item.frame);
+        annotations->setCurves(page->drawCurves(), page->annotationCache());
+        annotations->setPos(-pageRect.topLeft());
+
+        mItems.append(item);
+    }
+
+    setSceneRect(itemsBoundingRect());
+}
+
+void CompositeScene::clearPages()
+{
+    for (int i = 0; i < mItems.count(); i++) {
+        Item& item = mItems[i];
+        if (item.resident) {
+            item.image->release();
+        }
+    }
+    mItems.clear();
+    clear();
+}
+
+QRectF CompositeScene::pageRect(int index)
+{
+    if ((index < 0) || (index >= mItems.count())) { return QRectF(); }
+    return mItems[index].frame->sceneBoundingRect();
+}
+
+int CompositeScene::pageAt(QPointF pos)
+{
+    int nearest = -1;
+    qreal nearestDist = 0;
+    for (int i = 0; i < mItems.count(); i++) {
+        QRectF rect = mItems[i].frame->sceneBoundingRect();
+        if (rect.contains(pos)) { return i; }
+        qreal dist = qAbs(rect.center().y() - pos.y()) + qAbs(rect.center().x() - pos.x());
+        if ((nearest < 0) || (dist < nearestDist)) {
+            nearest = i;
+            nearestDist = dist;
+        }
+    }
+    return nearest;
+}
+
+void CompositeScene::setVisibleRect(QRectF rect)
+{
+    mVisibleRect = rect;
+
+    // Also load pages just outside the visible rect so scrolling doesn't
+    // show empty pages
+    QRectF loadRect = rect.adjusted(0, -rect.height() / 2, 0, rect.height() / 2);
+
+    for (int i = 0; i < mItems.count(); i++) {
+        Item& item = mItems[i];
+        if (!item.image) {
+            showPreview(item);
+            continue;
+        }
+        if (item.preview) {
+            item.pixmap->setPixmap(QPixmap());
+            item.pixmap->setTransform(QTransform());
+            item.pixmap->setTransformationMode(Qt::FastTransformation);
+            item.preview = false;
+        }
+
+        bool visible = item.frame->sceneBoundingRect().intersects(loadRect);
+        if (visible && !item.resident) {
+            item.pixmap->setPixmap(item.image->acquire());
+            item.resident = true;
+        } else if (!visible && item.resident) {
+            item.pixmap->setPixmap(QPixmap());
+            item.image->release();
+            item.resident = false;
+        }
+    }
+}
+
+void CompositeScene::updatePageImage(PagePtr page)
+{
+    for (int i = 0; i < mItems.count(); i++) {
+        Item& item = mItems[i];
+        if ((item.page != page) || (item.image == page->pageImage())) { continue; }
+
+        if (item.resident) {
+            item.pixmap->setPixmap(QPixmap());
+            item.image->release();
+            item.resident = false;
+        }
+        item.image = page->pageImage();
+    }
+    setVisibleRect(mVisibleRect);
+}
+
+void CompositeScene::showPreview(Item& item)
+{
+    if (item.preview || !item.page->hasPreview()) { return; }
+
+    // Stretched to the page geometry, as in PageScene
+    QImage preview = item.page->preview();
+    QRectF rect = item.page->imageRect();
+    item.pixmap->setPixmap(QPixmap::fromImage(preview));
+    item.pixmap->setTransformationMode(Qt::SmoothTransformation);
+    item.pixmap->setTransform(QTransform::fromScale(
+            rect.width() / (qreal)preview.width(),
+            rect.height() / (qreal)preview.height()));
+    item.preview = true;
+}
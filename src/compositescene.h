@@ -0,0 +1,71 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef COMPOSITESCENE_H
+#define COMPOSITESCENE_H
+
+#include "page.h"
+
+#include <QGraphicsScene>
+
+// Scene showing several pages at once, side by side (two-page spread) or
+// stacked vertically (continuous scrolling). Each page is shown cropped to its
+// page rectangle, with its drawings. Only pages intersecting the visible rect
+// set with setVisibleRect() have their pixmaps loaded. Pages that are not
+// rendered yet show their low resolution preview, if any.
+class CompositeScene : public QGraphicsScene
+{
+public:
+    CompositeScene();
+    ~CompositeScene();
+
+    enum class Layout { SideBySide, Vertical };
+
+    void setPages(QList<PagePtr> pages, Layout layout);
+    void clearPages();
+
+    // Scene rect of the page with the given index
+    QRectF pageRect(int index);
+    // Index of the page at the scene position, or the nearest page
+    int pageAt(QPointF pos);
+
+    void setVisibleRect(QRectF rect);
+    // Update the shown image after the page's image or preview changed
+    void updatePageImage(PagePtr page);
+
+private:
+    struct Item {
+        PagePtr page;
+        // Image at the time the pages were set, which is what was acquired
+        PageImagePtr image;
+        QGraphicsRectItem* frame = nullptr;
+        QGraphicsPixmapItem* pixmap = nullptr;
+        bool resident = false;
+        bool preview = false;
+    };
+    void showPreview(Item& item);
+    QList<Item> mItems;
+    QRectF mVisibleRect;
+
+    // Space between pages in scene units
+    const qreal gap = 20;
+};
+
+#endif // COMPOSITESCENE_H
@@ -28,7 +28,19 @@ DrawCurve::DrawCurve()
 
 DrawCurve::~DrawCurve()
 {
+    // Items still in a scene are deleted by the scene
+    if (mScenePath && !mScenePath->scene()) {
+        delete mScenePath;
+    }
+}
 
+QPen DrawCurve::pen()
+{
+    QPen pen;
+    pen.setCosmetic(true);
+    pen.setColor(Qt::red);
+    pen.setWidth(2);
+    return pen;
 }
 
 QPainterPath DrawCurve::painterPath()
@@ -42,11 +54,7 @@ QGraphicsPathItem* DrawCurve::scenePathItem()
     if (!mScenePath) {
         mScenePath = new QGraphicsPathItem();
         mScenePath->setZValue(10);
-        QPen pen;
-        pen.setCosmetic(true);
-        pen.setColor(Qt::red);
-        pen.setWidth(2);
-        mScenePath->setPen(pen);
+        mScenePath->setPen(pen());
     }
     mScenePath->setPath(mPainterPath);
 
@@ -94,13 +102,24 @@ QList<QLineF> DrawCurve::lines() const
     return mLines;
 }
 
+qint64 DrawCurve::memoryBytes()
+{
+    return mPainterPath.elementCount() * sizeof(QPainterPath::Element)
+            + mLines.count() * sizeof(QLineF);
+}
+
 QJsonObject DrawCurve::toJson()
+{
+    return pathToJson(mPainterPath);
+}
+
+QJsonObject DrawCurve::pathToJson(const QPainterPath& path)
 {
     QJsonObject obj;
 
     QJsonArray points;
-    for (int i = 0; i < mPainterPath.elementCount(); i++) {
-        QPainterPath::Element e = mPainterPath.elementAt(i);
+    for (int i = 0; i < path.elementCount(); i++) {
+        QPainterPath::Element e = path.elementAt(i);
         QJsonObject point;
         point.insert("x", e.x);
         point.insert("y", e.y);
@@ -33,14 +33,22 @@ public:
     DrawCurve();
     ~DrawCurve();
 
+    // Pen all curves are drawn with
+    static QPen pen();
+
     QPainterPath painterPath();
+    // Item for showing the curve while it is being drawn
     QGraphicsPathItem* scenePathItem();
     void addPoint(QPointF point);
     bool intersects(DrawCurve* otherCurve);
     bool linesIntersect(const QLineF& line1, const QLineF& line2);
     QList<QLineF> lines() const;
+    // Estimated memory used by the curve data
+    qint64 memoryBytes();
 
     QJsonObject toJson();
+    // JSON of a curve's painter path. May be used from any thread.
+    static QJsonObject pathToJson(const QPainterPath& path);
     void fromJson(QJsonObject obj);
 
 private:
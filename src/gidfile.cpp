@@ -106,19 +106,20 @@ GidFile::ReadResult GidFile::read(QString filename)
     ReadResult ret;
     ret.result.filename = filename;
 
-    QFile f(filename);
-    if (!f.exists()) {
+    QString path = filename;
+    if (!QFile::exists(path)) {
         // File does not exist. Try the backup file.
-        f.setFileName(f.fileName() + oldSuffix);
+        path = filename + oldSuffix;
     }
-    if (!f.open(QIODevice::ReadOnly)) {
+    MappedFilePtr f = MappedFile::open(path);
+    if (!f->isOpen()) {
         ret.result.success = false;
-        ret.result.errorString = "Failed to open file: " + f.errorString();
+        ret.result.errorString = "Failed to open file: " + f->errorString();
         return ret;
     }
 
-    ret.data = f.readAll();
-    f.close();
+    ret.mapping = f;
+    ret.data = f->data();
 
     ret.result.success = true;
     return ret;
@@ -43,6 +43,8 @@
 #ifndef GIDFILE_H
 #define GIDFILE_H
 
+#include "mappedfile.h"
+
 #include <QByteArray>
 #include <QString>
 
@@ -63,7 +65,10 @@ public:
 
     struct ReadResult {
         Result result;
+        // Refers to a read-only memory mapping of the file (kept alive by
+        // the mapping member), so the file is not copied to the heap.
         QByteArray data;
+        MappedFilePtr mapping;
     };
 
     static Result write(QString filename, QByteArray data);
@@ -0,0 +1,209 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "imagefilters.h"
+
+#include <QPainter>
+#include <QtAlgorithms>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+QImage ImageFilters::process(QImage image, RenderOptions options)
+{
+    if (options.mode == RenderMode::Color) {
+        if (options.enhanceContrast && image.allGray()) {
+            // Color mode, but the page has no color anyway
+            image = toGrayscale(image);
+            levels(image, blackLevel, whiteLevel);
+        }
+        return image;
+    }
+
+    image = toGrayscale(image);
+    if (options.enhanceContrast) {
+        levels(image, blackLevel, whiteLevel);
+    }
+    if (options.mode == RenderMode::Mono) {
+        image = toMono(image);
+    }
+    return image;
+}
+
+QImage ImageFilters::toGrayscale(QImage image)
+{
+    if (image.format() == QImage::Format_Grayscale8) { return image; }
+
+    // Pages are rendered with a transparent background. Flatten onto white
+    // first, otherwise the background becomes black.
+    if (image.hasAlphaChannel()) {
+        QImage flat(image.size(), QImage::Format_RGB32);
+        flat.fill(Qt::white);
+        QPainter painter(&flat);
+        painter.drawImage(0, 0, image);
+        painter.end();
+        image = flat;
+    }
+
+    return image.convertToFormat(QImage::Format_Grayscale8);
+}
+
+void ImageFilters::levels(QImage& grayImage, int black, int white)
+{
+    if (grayImage.format() != QImage::Format_Grayscale8) { return; }
+
+    black = qBound(0, black, 254);
+    white = qBound(black + 1, white, 255);
+
+    // out = (in - black) * 255 / (white - black), clamped to 0..255.
+    // In fixed point: out = ((in - black) * k) >> 8 with k = 255*256/(white - black)
+    // rounded up, so that in = white gives exactly 255.
+    const int range = white - black;
+    const int k = (255 * 256 + range - 1) / range;
+
+    uchar lut[256];
+    for (int i = 0; i < 256; i++) {
+        lut[i] = (uchar)qBound(0, ((i - black) * k) >> 8, 255);
+    }
+
+    const int w = grayImage.width();
+    for (int y = 0; y < grayImage.height(); y++) {
+        uchar* line = grayImage.scanLine(y);
+        int x = 0;
+
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i vblack = _mm_set1_epi8((char)black);
+        const __m128i vrange = _mm_set1_epi8((char)range);
+        const __m128i vk = _mm_set1_epi16((short)k);
+        for (; x + 16 <= w; x += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(line + x));
+            // Saturating subtract clamps values below black to 0 and min
+            // clamps values above white to white
+            v = _mm_subs_epu8(v, vblack);
+            v = _mm_min_epu8(v, vrange);
+            // Widen to 16 bits, shifted up by 8 so mulhi gives (v * k) >> 8
+            __m128i lo = _mm_unpacklo_epi8(zero, v);
+            __m128i hi = _mm_unpackhi_epi8(zero, v);
+            lo = _mm_mulhi_epu16(lo, vk);
+            hi = _mm_mulhi_epu16(hi, vk);
+            _mm_storeu_si128((__m128i*)(line + x), _mm_packus_epi16(lo, hi));
+        }
+#endif
+
+        for (; x < w; x++) {
+            line[x] = lut[line[x]];
+        }
+    }
+}
+
+QImage ImageFilters::toMono(QImage grayImage)
+{
+    return grayImage.convertToFormat(QImage::Format_Mono,
+                                     Qt::MonoOnly | Qt::ThresholdDither);
+}
+
+// Index of the first pixel darker than threshold in line[from, to), or -1
+static int firstDark(const uchar* line, int from, int to, int threshold)
+{
+    int x = from;
+#ifdef __SSE2__
+    const __m128i vmax = _mm_set1_epi8((char)(threshold - 1));
+    for (; x + 16 <= to; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(line + x));
+        // v == min(v, threshold - 1) means v < threshold
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, vmax), v));
+        if (mask) {
+            return x + qCountTrailingZeroBits((quint32)mask);
+        }
+    }
+#endif
+    for (; x < to; x++) {
+        if (line[x] < threshold) { return x; }
+    }
+    return -1;
+}
+
+// Index of the last pixel darker than threshold in line[from, to), or -1
+static int lastDark(const uchar* line, int from, int to, int threshold)
+{
+    int x = to;
+#ifdef __SSE2__
+    const __m128i vmax = _mm_set1_epi8((char)(threshold - 1));
+    for (; x - 16 >= from; x -= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(line + x - 16));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, vmax), v));
+        if (mask) {
+            return x - 16 + 31 - qCountLeadingZeroBits((quint32)mask);
+        }
+    }
+#endif
+    for (x = x - 1; x >= from; x--) {
+        if (line[x] < threshold) { return x; }
+    }
+    return -1;
+}
+
+QRect ImageFilters::contentBounds(QImage image, int threshold)
+{
+    if (image.isNull()) { return QRect(); }
+    if (image.format() == QImage::Format_Mono) {
+        image = image.convertToFormat(QImage::Format_Grayscale8);
+    }
+    QImage gray = toGrayscale(image);
+
+    const int w = gray.width();
+    const int h = gray.height();
+    threshold = qBound(1, threshold, 255);
+
+    auto rowHasContent = [&](int y) {
+        return firstDark(gray.constScanLine(y), 0, w, threshold) >= 0;
+    };
+
+    // Top and bottom: every row is checked, as staff lines and small
+    // markings may be only a pixel or two high. Only the blank margins are
+    // scanned in full, a row with content stops at its first dark pixel.
+    int top = -1;
+    for (int y = 0; y < h; y++) {
+        if (rowHasContent(y)) { top = y; break; }
+    }
+    if (top < 0) { return QRect(); }
+
+    int bottom = top;
+    for (int y = h - 1; y > top; y--) {
+        if (rowHasContent(y)) { bottom = y; break; }
+    }
+
+    // Left and right: only the part outside the bounds found so far needs to
+    // be searched on each row
+    int left = w;
+    int right = -1;
+    for (int y = top; y <= bottom; y++) {
+        const uchar* line = gray.constScanLine(y);
+        int l = firstDark(line, 0, left, threshold);
+        if (l >= 0) { left = l; }
+        int r = lastDark(line, right + 1, w, threshold);
+        if (r >= 0) { right = r; }
+    }
+    if (right < left) { return QRect(); }
+
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
@@ -18,7 +18,9 @@
  *
  *****************************************************************************/
 
+#include "commandserver.h"
 #include "mainwindow.h"
+#include "startuptimeline.h"
 #include "version.h"
 
 #include <QApplication>
@@ -47,17 +49,34 @@ void printHelp()
     print("");
     print("help | -h | --help   Show this help message.");
     print("-v | --version       Print version info and exit.");
+    print("--socket <name>      Name of the local command socket. Default: "
+          + CommandServer::defaultServerName);
+    print("--send <command>     Send a command to a running instance and exit, e.g.");
+    print("                     --send next, --send prev, --send \"page 3\",");
+    print("                     --send \"doc 2 1\"");
+    print("--no-midi            Don't create a MIDI input port.");
+    print("--sync-leader        Broadcast page changes to sync followers.");
+    print("--sync-follower      Follow the page changes of the sync leader.");
+    print("--sync-name <name>   Name of the local sync socket. Default: "
+          + SyncLink::defaultServerName);
     print("");
     //    |--------------------------------------------------------------------------------|
 }
 
 int main(int argc, char *argv[])
 {
+    StartupTimeline::start();
     printVersion();
 
     QStringList helpArgs {"help", "-h", "--help"};
     QStringList versionArgs {"-v", "--version"};
 
+    QString socketName = CommandServer::defaultServerName;
+    QString sendCommand;
+    bool midi = true;
+    SyncLink::Role syncRole = SyncLink::Role::None;
+    QString syncName = SyncLink::defaultServerName;
+
     for (int i=1; i < argc; i++) {
         QString arg(argv[i]);
         if (helpArgs.contains(arg)) {
@@ -66,13 +85,37 @@ int main(int argc, char *argv[])
         } else if (versionArgs.contains(arg)) {
             // Version info already printed at start. Just exit.
             return 0;
+        } else if ((arg == "--socket") && (i + 1 < argc)) {
+            socketName = QString(argv[++i]);
+        } else if ((arg == "--send") && (i + 1 < argc)) {
+            sendCommand = QString(argv[++i]);
+        } else if (arg == "--no-midi") {
+            midi = false;
+        } else if (arg == "--sync-leader") {
+            syncRole = SyncLink::Role::Leader;
+        } else if (arg == "--sync-follower") {
+            syncRole = SyncLink::Role::Follower;
+        } else if ((arg == "--sync-name") && (i + 1 < argc)) {
+            syncName = QString(argv[++i]);
         } else {
             print("Unknown argument: " + arg);
         }
     }
 
+    if (!sendCommand.isEmpty()) {
+        QCoreApplication a(argc, argv);
+        QString reply = CommandServer::send(socketName, sendCommand);
+        print(reply);
+        return reply == "ok" ? 0 : 1;
+    }
+
     QApplication a(argc, argv);
+    StartupTimeline::mark("Application created");
     MainWindow w;
+    StartupTimeline::mark("Main window created");
+    w.startCommandServer(socketName, midi);
+    w.startSync(syncRole, syncName);
     w.show();
+    StartupTimeline::mark("Main window shown");
     return a.exec();
 }
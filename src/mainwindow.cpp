@@ -21,30 +21,38 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include <QApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QGraphicsPixmapItem>
+#include <QInputDialog>
 #include <QMessageBox>
-#include <QPdfDocument>
+#include <QPainter>
 #include <QScreen>
+#include <QScrollBar>
+#include <QSet>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include <algorithm>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
-
-    updateAboutPage();
+    StartupTimeline::mark("UI set up");
 
     ui->label_settingsLocation->setText(QSettings().fileName());
+    setupSettings();
 
     // Set the icon size settings defaults to those specified in the GUI
     settings.iconsHorizontalSize.setDefaultValue(ui->toolBar_main->iconSize().width());
     settings.iconsVerticalSize.setDefaultValue(ui->toolBar_main->iconSize().height());
     updateToolbarIconSizeFromSettings();
 
-    makeAllToolbarsCentered();
-
     setFullscreen(settings.fullscreen.value().toBool());
 
     updateWindowTitle();
@@ -53,10 +61,24 @@ MainWindow::MainWindow(QWidget *parent)
     setupBreadcrumbs();
     updateBreadcrumbs();
     setupGraphicsView();
+    setupHalfTurn();
+    setupUndo();
+    setupRenderScheduler();
+    setupMemoryGovernor();
+
+    // Detect the first frame, see eventFilter()
+    ui->graphicsView->viewport()->installEventFilter(this);
 
     QString lastSession = settings.lastSession.string();
     if (!lastSession.isEmpty()) {
-        openSession(lastSession);
+        // Show the last viewed page at once if possible and read the session
+        // after the first frame
+        mStartupSnapshot = StartupSnapshot::load();
+        if (mStartupSnapshot.isValidFor(lastSession) && showStartupSnapshot()) {
+            mDeferredSession = lastSession;
+        } else {
+            openSession(lastSession);
+        }
     }
 }
 
@@ -65,22 +87,24 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
-void MainWindow::makeAllToolbarsCentered()
+void MainWindow::centerToolbar(QToolBar* toolbar)
 {
-    foreach (QToolBar* toolbar, allToolbars()) {
-        // Insert expanding widgets at beginning and end
-        QWidget* w1 = new QWidget(this);
-        w1->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
-        toolbar->insertWidget(toolbar->actions().value(0), w1);
+    if (toolbar->property("centered").toBool()) { return; }
+    toolbar->setProperty("centered", true);
 
-        QWidget* w2 = new QWidget(this);
-        w2->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
-        toolbar->addWidget(w2);
-    }
+    // Insert expanding widgets at beginning and end
+    QWidget* w1 = new QWidget(this);
+    w1->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    toolbar->insertWidget(toolbar->actions().value(0), w1);
+
+    QWidget* w2 = new QWidget(this);
+    w2->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    toolbar->addWidget(w2);
 }
 
 void MainWindow::showOnlyToolbar(QToolBar* toolbar)
 {
+    centerToolbar(toolbar);
     foreach (QToolBar* tb, allToolbars()) {
         tb->setVisible(tb == toolbar);
     }
@@ -111,6 +135,14 @@ void MainWindow::updateToolbarIconSizeFromSettings()
 
 void MainWindow::openSession(QString filepath)
 {
+    // Keep the pixmap of a shown startup snapshot while the session is read,
+    // as the same render is shown again from the session page
+    PageImagePtr snapshotImage;
+    if (mSnapshotPage) {
+        snapshotImage = mSnapshotPage->pageImage();
+        if (snapshotImage) { snapshotImage->acquire(); }
+    }
+
     // Clear current session
     clearSession();
 
@@ -127,49 +159,82 @@ void MainWindow::openSession(QString filepath)
 
     print("Read session file " + filepath);
 
-    // Create documents from JSON
-    QJsonDocument jin = QJsonDocument::fromJson(r.data);
-    QJsonArray jdocs = jin.array();
-    foreach (QJsonValue jval, jdocs) {
-        QJsonObject jdoc = jval.toObject();
-        DocumentPtr doc(new Document());
-        doc->name = jdoc.value("name").toString();
-        doc->filepath = jdoc.value("filepath").toString();
-        QJsonArray jpages = jdoc.value("pages").toArray();
-        foreach (QJsonValue jvpage, jpages) {
-            QJsonObject jpage = jvpage.toObject();
-
-            PageScenePtr page(new PageScene());
-            page->setCropRect(jsonToRect(jpage.value("rect").toObject()));
-            page->setPageRectToCropRect();
-            QJsonArray jcurves = jpage.value("drawCurves").toArray();
-            foreach (QJsonValue jvcurve, jcurves) {
-                QJsonObject jcurve = jvcurve.toObject();
-                DrawCurvePtr d(new DrawCurve());
-                d->fromJson(jcurve);
-                page->addDrawCurve(d);
-            }
+    // Set current session path before loading PDFs, as it may be used while loading
+    setSessionFilepath(filepath);
 
-            doc->pages.append(page);
-            updateBreadcrumbs();
+    // The first document is read and its PDF opened in the background while
+    // the other documents are read in parallel. Documents are added in order.
+    QElapsedTimer timer;
+    timer.start();
+    SessionReader reader(r.data);
+    SessionReader::Document entry;
+    QList<SessionReader::Document> entries;
+    QString error;
+    documents.beginBatch();
+    if (reader.readDocument(&entry)) {
+        DocumentPtr doc = addSessionDocument(entry);
+        loadPdfs({doc});
+
+        QList<QByteArray> data;
+        QByteArray docData;
+        while (reader.skipDocument(&docData)) {
+            data.append(docData);
         }
-        documents.add(doc);
+        entries = SessionReader::readDocuments(data, &error);
     }
+    if (error.isEmpty()) { error = reader.errorString(); }
 
-    // Set current session path before loading PDFs, as it may be used while loading
-    setSessionFilepath(filepath);
-
-    // Load PDFs
-    foreach (DocumentPtr doc, documents.all()) {
-        loadPdf(doc);
+    QList<DocumentPtr> toLoad;
+    foreach (const SessionReader::Document& e, entries) {
+        toLoad.append(addSessionDocument(e));
+    }
+    documents.endBatch();
+    if (!error.isEmpty()) {
+        print(QString("Error reading session file %1: %2")
+              .arg(filepath).arg(error));
+    }
+    print(QString("Read %1 documents in %2 ms")
+          .arg(documents.count()).arg(timer.elapsed()));
+    StartupTimeline::mark("Session read");
+
+    // Continue at the last viewed position if this is the session of the
+    // startup snapshot. Its renders are used once the PDFs are open.
+    DocumentPtr viewDoc = documents.value(0);
+    int viewPageIndex = 0;
+    if (mStartupSnapshot.isValidFor(filepath)) {
+        DocumentPtr doc = documents.value(mStartupSnapshot.docIndex);
+        if (doc && (mStartupSnapshot.pageIndex < doc->pages.count())) {
+            viewDoc = doc;
+            viewPageIndex = mStartupSnapshot.pageIndex;
+        }
+        // Position is only restored once
+        mStartupSnapshot.sessionFilepath.clear();
+        attachStartupSnapshotRenders();
+    } else {
+        mStartupSnapshot = StartupSnapshot();
     }
 
-    viewPage(documents.value(0), 0);
+    // Session can be navigated while the PDFs are opened in the background
+    viewPage(viewDoc, viewPageIndex);
+    loadPdfs(toLoad);
+    if (snapshotImage) { snapshotImage->release(); }
 
     settings.lastSession.set(filepath);
     setSessionModified(false);
 }
 
+MainWindow::DocumentPtr MainWindow::addSessionDocument(
+        const SessionReader::Document& entry)
+{
+    DocumentPtr doc(new Document());
+    doc->name = entry.name;
+    doc->filepath = entry.filepath;
+    doc->pageRange = entry.pageRange;
+    doc->pages = entry.pages;
+    documents.add(doc);
+    return doc;
+}
+
 bool MainWindow::saveSession()
 {
     bool saved = false;
@@ -224,6 +289,29 @@ bool MainWindow::msgBoxYesNo(QString title, QString text)
     return QMessageBox::question(this, title, text) == QMessageBox::Yes;
 }
 
+void MainWindow::startCommandServer(QString name, bool midi)
+{
+    commandServer.setHandler([=](CommandServer::Command command)
+    {
+        return onExternalCommand(command);
+    });
+
+    if (commandServer.listen(name)) {
+        print("Listening for commands on local socket " + name);
+    } else {
+        print("Could not listen on local socket " + name + ": "
+              + commandServer.errorString());
+    }
+
+    if (midi) {
+        if (commandServer.startMidi()) {
+            print("MIDI input port created");
+        } else {
+            print("No MIDI input: " + commandServer.errorString());
+        }
+    }
+}
+
 void MainWindow::updateWindowTitle()
 {
     QString text;
@@ -279,6 +367,74 @@ QFont MainWindow::getMonospaceFont()
     return font;
 }
 
+void MainWindow::setupSettings()
+{
+    // Order must match ImageFilters::RenderMode
+    ui->comboBox_renderMode->addItems({"Color", "Grayscale", "Black and white"});
+    ui->comboBox_renderMode->setCurrentIndex(settings.renderMode.value().toInt());
+    ui->checkBox_enhanceContrast->setChecked(settings.enhanceContrast.value().toBool());
+    applyRenderSettings(false);
+
+    // Order must match ViewMode
+    ui->comboBox_viewMode->addItems({"Single page", "Two pages", "Continuous",
+                                     "Half-page turn"});
+    ui->comboBox_viewMode->setCurrentIndex(settings.viewMode.value().toInt());
+    mViewMode = (ViewMode)settings.viewMode.value().toInt();
+
+    connect(ui->comboBox_viewMode, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, [=](int index)
+    {
+        settings.viewMode.set(index);
+        setViewMode((ViewMode)index);
+    });
+
+    connect(ui->comboBox_renderMode, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, [=](int index)
+    {
+        settings.renderMode.set(index);
+        applyRenderSettings(true);
+    });
+
+    connect(ui->checkBox_enhanceContrast, &QCheckBox::toggled,
+            this, [=](bool checked)
+    {
+        settings.enhanceContrast.set(checked);
+        applyRenderSettings(true);
+    });
+
+    bool scrub = settings.breadcrumbScrub.value().toBool();
+    ui->checkBox_breadcrumbScrub->setChecked(scrub);
+    ui->widget_docsBreadcrumbs->setScrubEnabled(scrub);
+    ui->widget_pagesBreadcrumbs->setScrubEnabled(scrub);
+    connect(ui->checkBox_breadcrumbScrub, &QCheckBox::toggled,
+            this, [=](bool checked)
+    {
+        settings.breadcrumbScrub.set(checked);
+        ui->widget_docsBreadcrumbs->setScrubEnabled(checked);
+        ui->widget_pagesBreadcrumbs->setScrubEnabled(checked);
+    });
+}
+
+void MainWindow::applyRenderSettings(bool reload)
+{
+    ImageFilters::RenderOptions options;
+    options.mode = (ImageFilters::RenderMode)settings.renderMode.value().toInt();
+    options.enhanceContrast = settings.enhanceContrast.value().toBool();
+    pdfRegistry.setRenderOptions(options);
+
+    if (reload) {
+        // Re-render all documents with the new options
+        foreach (DocumentPtr doc, documents.all()) {
+            loadPdf(doc);
+        }
+        updateResidentPages();
+        scheduleRenders();
+        // Rebuild composite scene with the new renders
+        mCompositeDoc.reset();
+        viewPage(currentDoc, currentPage);
+    }
+}
+
 void MainWindow::showMainPagesView()
 {
     ui->stackedWidget->setCurrentWidget(ui->page_main);
@@ -297,6 +453,33 @@ void MainWindow::showDocOrderView()
     }
 }
 
+void MainWindow::showThumbnailsView()
+{
+    QList<ThumbnailsWidget::Item> items;
+    mThumbnailPages.clear();
+    int current = -1;
+
+    for (int idoc = 0; idoc < documents.count(); idoc++) {
+        DocumentPtr doc = documents.value(idoc);
+        for (int ipage = 0; ipage < doc->pages.count(); ipage++) {
+            if ((doc == currentDoc) && (ipage == currentPage)) {
+                current = items.count();
+            }
+            ThumbnailsWidget::Item item;
+            item.filepath = doc->resolvedFilepath;
+            item.pdfPage = doc->pdfPages.value(ipage, ipage);
+            item.label = QString("%1 - %2").arg(idoc + 1).arg(ipage + 1);
+            items.append(item);
+            mThumbnailPages.append(qMakePair(doc, ipage));
+        }
+    }
+
+    ui->widget_thumbnails->setItems(items);
+    ui->widget_thumbnails->setCurrent(current);
+    ui->stackedWidget->setCurrentWidget(ui->page_thumbnails);
+    ui->widget_thumbnails->scrollToIndex(current);
+}
+
 void MainWindow::print(QString msg)
 {
     ui->plainTextEdit->appendPlainText(msg);
@@ -315,6 +498,10 @@ void MainWindow::setupGraphicsView()
             this, &MainWindow::onGraphicsViewLeftMouseDragEnd);
     connect(ui->graphicsView, &GraphicsView::resized,
             this, &MainWindow::onGraphicsViewResized);
+    connect(ui->graphicsView->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &MainWindow::onCompositeScrolled);
+    connect(ui->graphicsView->horizontalScrollBar(), &QScrollBar::valueChanged,
+            this, &MainWindow::onCompositeScrolled);
 }
 
 void MainWindow::enableCropping(bool enable)
@@ -324,13 +511,112 @@ void MainWindow::enableCropping(bool enable)
     if (!enable) {
         // Exiting crop mode. Apply crop to all pages of all documents
         foreach (DocumentPtr doc, documents.all()) {
-            foreach (PageScenePtr page, doc->pages) {
+            foreach (PagePtr page, doc->pages) {
                 page->setPageRectToCropRect();
             }
         }
+        mCompositeDoc.reset();
     }
 
-    scaleScene();
+    // Switch between the single page and composite view
+    viewPage(currentDoc, currentPage);
+}
+
+struct AutoCropPage {
+    PageImagePtr image;
+    // Used to render the page if it isn't rendered
+    PdfSourcePtr source;
+    int pdfPage = -1;
+};
+
+static QRect pageContentBounds(const AutoCropPage& page)
+{
+    QImage image;
+    if (page.image) {
+        image = page.image->image();
+    } else if (page.source) {
+        // Not rendered (renders are lazy and may have been evicted)
+        image = page.source->renderUncached(page.pdfPage);
+    }
+    if (image.isNull()) { return QRect(); }
+
+    QRect bounds = ImageFilters::contentBounds(image);
+    if (bounds.isNull()) { return bounds; }
+
+    // Leave a small margin around the content
+    int margin = qMin(image.width(), image.height()) / 100;
+    bounds.adjust(-margin, -margin, margin, margin);
+    return bounds.intersected(image.rect());
+}
+
+void MainWindow::autoCrop(QList<PagePtr> pages)
+{
+    QList<AutoCropPage> cropPages;
+    int notLoaded = 0;
+    foreach (PagePtr page, pages) {
+        AutoCropPage cropPage;
+        cropPage.image = page->pageImage();
+        if (!cropPage.image) {
+            foreach (DocumentPtr doc, documents.all()) {
+                int index = doc->pages.indexOf(page);
+                if (index < 0) { continue; }
+                cropPage.pdfPage = doc->pdfPages.value(index, -1);
+                if (cropPage.pdfPage >= 0) { cropPage.source = doc->source; }
+                break;
+            }
+            if (!cropPage.source) { notLoaded++; }
+        }
+        cropPages.append(cropPage);
+    }
+
+    // Pages are scanned (and rendered if needed) in parallel on the global
+    // thread pool
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QList<QRect> bounds = QtConcurrent::blockingMapped<QList<QRect>>(
+                cropPages, pageContentBounds);
+    QApplication::restoreOverrideCursor();
+
+    QList<PagePtr> changed;
+    QList<QRectF> oldCropRects;
+    QList<QRectF> oldPageRects;
+    int cropped = 0;
+    for (int i = 0; i < pages.count(); i++) {
+        // Blank pages, and pages of PDFs that aren't loaded, are left as they
+        // are
+        if (bounds[i].isNull()) { continue; }
+        changed.append(pages[i]);
+        oldCropRects.append(pages[i]->getCropRect());
+        oldPageRects.append(pages[i]->getPageRect());
+        pages[i]->setCropRect(bounds[i]);
+        if (!mIsCropping) {
+            pages[i]->setPageRectToCropRect();
+        }
+        cropped++;
+    }
+    print(QString("Auto crop: cropped %1 of %2 pages, %3 blank, %4 not loaded")
+          .arg(cropped).arg(pages.count())
+          .arg(pages.count() - cropped - notLoaded).arg(notLoaded));
+
+    if (cropped) {
+        QList<QRectF> newCropRects;
+        QList<QRectF> newPageRects;
+        foreach (PagePtr page, changed) {
+            newCropRects.append(page->getCropRect());
+            newPageRects.append(page->getPageRect());
+        }
+        auto setRects = [=](QList<QRectF> cropRects, QList<QRectF> pageRects)
+        {
+            for (int i = 0; i < changed.count(); i++) {
+                changed[i]->setCropRect(cropRects[i]);
+                changed[i]->setPageRect(pageRects[i]);
+            }
+        };
+        pushPageEdit("Auto Crop", currentDoc, currentPage,
+                     [=]() { setRects(oldCropRects, oldPageRects); },
+                     [=]() { setRects(newCropRects, newPageRects); },
+                     changed.count() * 4 * sizeof(QRectF));
+        scaleScene();
+    }
 }
 
 void MainWindow::setDrawPen()
@@ -354,10 +640,11 @@ void MainWindow::unZoom()
     if (mIsZoomed) {
         mIsZoomed = false;
         scaleScene();
+        broadcastPosition();
 
         // Hide zoom rectangle
         if (currentDoc) {
-            PageScenePtr page = currentDoc->pages.value(currentPage);
+            PagePtr page = currentDoc->pages.value(currentPage);
             if (page) {
                 page->showZoomRect(false);
             }
@@ -377,95 +664,834 @@ void MainWindow::viewPage(DocumentPtr doc, int pageIndex)
 {
     if (!doc) { return; }
 
-    PageScenePtr page = doc->pages.value(pageIndex);
+    PagePtr page = doc->pages.value(pageIndex);
     if (!page) { return; }
 
     unZoom();
 
-    ui->graphicsView->setScene(page.data());
-    QMetaObject::invokeMethod(this, &MainWindow::scaleScene, Qt::QueuedConnection);
-
     currentDoc = doc;
     currentPage = pageIndex;
+    updateResidentPages();
+    scheduleRenders();
+
+    mHalfTurned = false;
+    if (usesCompositeView()) {
+        showCompositePages();
+    } else {
+        // Bind the next page ahead of the turn, then the current page so it
+        // is the most recently used scene in the pool
+        QPair<DocumentPtr, int> next = pageAfter(doc, pageIndex);
+        if (next.first) {
+            scenePool.sceneFor(next.first->pages.value(next.second));
+        }
+        ui->graphicsView->setScene(scenePool.sceneFor(page));
+    }
+    QMetaObject::invokeMethod(this, &MainWindow::scaleScene, Qt::QueuedConnection);
+
+    if ((mViewMode == ViewMode::HalfPage) && !mIsCropping && !mIsDrawing) {
+        prepareHalfTurn();
+    }
+    broadcastPosition();
+
     updateBreadcrumbs();
     updateWindowTitle();
 }
 
-void MainWindow::scaleScene()
-{
-    if (!currentDoc) { return; }
-    PageScenePtr page = currentDoc->pages.value(currentPage);
-    if (!page) { return; }
+void MainWindow::setViewMode(ViewMode mode)
+{
+    mViewMode = mode;
+    mCompositeDoc.reset();
+    viewPage(currentDoc, currentPage);
+}
+
+bool MainWindow::usesCompositeView()
+{
+    bool composite = (mViewMode == ViewMode::TwoPages)
+                     || (mViewMode == ViewMode::Continuous);
+    return composite && !mIsCropping && !mIsDrawing;
+}
+
+void MainWindow::showCompositePages()
+{
+    if (mViewMode == ViewMode::TwoPages) {
+        // Current page on the left, next page (if any) on the right
+        QList<PagePtr> pages = currentDoc->pages.mid(currentPage, 2);
+        mCompositeScene.setPages(pages, CompositeScene::Layout::SideBySide);
+        mCompositeDoc.reset();
+    } else {
+        // Whole document is laid out once, page changes only scroll
+        if (mCompositeDoc != currentDoc) {
+            mCompositeScene.setPages(currentDoc->pages, CompositeScene::Layout::Vertical);
+            mCompositeDoc = currentDoc;
+        }
+        mScrollToCurrentPage = true;
+    }
+
+    if (ui->graphicsView->scene() != &mCompositeScene) {
+        ui->graphicsView->setScene(&mCompositeScene);
+    }
+}
+
+void MainWindow::scaleCompositeScene()
+{
+    QRectF rect = mCompositeScene.sceneRect();
+    if (rect.isEmpty()) { return; }
+
+    if (mViewMode == ViewMode::TwoPages) {
+        ui->graphicsView->fitInView(rect, Qt::KeepAspectRatio);
+        ui->graphicsView->centerOn(rect.center());
+    } else {
+        // Fit width, scroll vertically
+        qreal scale = ui->graphicsView->viewport()->width() / rect.width();
+        ui->graphicsView->setTransform(QTransform::fromScale(scale, scale));
+        if (mScrollToCurrentPage) {
+            mScrollToCurrentPage = false;
+            if (mScrollAnimation) { mScrollAnimation->stop(); }
+            QRectF pageRect = mCompositeScene.pageRect(currentPage);
+            qreal viewHeight = ui->graphicsView->viewport()->height() / scale;
+            ui->graphicsView->centerOn(rect.center().x(), pageRect.top() + viewHeight / 2);
+        }
+    }
+
+    onCompositeScrolled();
+}
+
+void MainWindow::onCompositeScrolled()
+{
+    if (ui->graphicsView->scene() != &mCompositeScene) { return; }
+
+    QRectF visible = ui->graphicsView->mapToScene(
+                ui->graphicsView->viewport()->rect()).boundingRect();
+    mCompositeScene.setVisibleRect(visible);
+
+    if ((mViewMode == ViewMode::Continuous) && currentDoc) {
+        // Current page follows the scroll position
+        int index = mCompositeScene.pageAt(visible.center());
+        if ((index >= 0) && (index != currentPage)) {
+            currentPage = index;
+            updateResidentPages();
+            scheduleRenders();
+            updateBreadcrumbs();
+            broadcastPosition();
+        }
+    }
+}
+
+bool MainWindow::scrollComposite(qreal fraction)
+{
+    QScrollBar* bar = ui->graphicsView->verticalScrollBar();
+
+    // Continue from the target of a scroll still in progress
+    int from = bar->value();
+    if (mScrollAnimation) {
+        from = mScrollAnimation->endValue().toInt();
+        mScrollAnimation->stop();
+    }
+
+    int to = qBound(bar->minimum(),
+                    from + (int)(fraction * ui->graphicsView->viewport()->height()),
+                    bar->maximum());
+    if (to == bar->value()) { return false; }
+
+    mScrollAnimation = new QPropertyAnimation(bar, "value", this);
+    mScrollAnimation->setDuration(150);
+    mScrollAnimation->setStartValue(bar->value());
+    mScrollAnimation->setEndValue(to);
+    mScrollAnimation->setEasingCurve(QEasingCurve::OutCubic);
+    mScrollAnimation->start(QAbstractAnimation::DeleteWhenStopped);
+    return true;
+}
+
+// Page (cropped) with its drawings, as input for a half-page turn composite
+struct HalfTurnPage
+{
+    PageImagePtr image;
+    QRect rect;
+    QList<QPainterPath> paths;
+};
+
+static HalfTurnPage halfTurnPage(PagePtr page)
+{
+    HalfTurnPage ret;
+    ret.image = page->pageImage();
+    ret.rect = page->getPageRect().toAlignedRect();
+    foreach (DrawCurvePtr curve, page->drawCurves()) {
+        ret.paths.append(curve->painterPath());
+    }
+    return ret;
+}
+
+static QImage renderHalfTurnPage(const HalfTurnPage& page)
+{
+    if (!page.image) { return QImage(); }
+
+    // Draw onto white, as a converted transparent background would be black
+    QImage image(page.rect.size(), QImage::Format_RGB32);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.translate(-page.rect.topLeft());
+    painter.drawImage(0, 0, page.image->image());
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(DrawCurve::pen());
+    foreach (const QPainterPath& path, page.paths) {
+        painter.drawPath(path);
+    }
+    return image;
+}
+
+// Bottom half of the current page with the top half of the next page above it
+static QImage composeHalfTurn(HalfTurnPage current, HalfTurnPage next)
+{
+    QImage image = renderHalfTurnPage(current);
+    QImage top = renderHalfTurnPage(next);
+    if (image.isNull() || top.isNull()) { return QImage(); }
+
+    top = top.scaledToWidth(image.width(), Qt::SmoothTransformation);
+    int half = image.height() / 2;
+
+    QPainter painter(&image);
+    painter.fillRect(0, 0, image.width(), half, Qt::white);
+    painter.drawImage(QPoint(0, 0), top, QRect(0, 0, top.width(), qMin(half, top.height())));
+    painter.setPen(QPen(Qt::gray, qMax(1, image.width() / 400)));
+    painter.drawLine(0, half, image.width(), half);
+    return image;
+}
+
+void MainWindow::setupHalfTurn()
+{
+    mHalfTurnScene.setBackgroundBrush(QBrush(Qt::gray));
+    mHalfTurnItem = mHalfTurnScene.addPixmap(QPixmap());
+
+    // Convert to a pixmap as soon as it is ready, not when it is needed
+    connect(&mHalfTurnWatcher, &QFutureWatcher<QImage>::finished, this, [=]()
+    {
+        mHalfTurnPixmap = QPixmap::fromImage(mHalfTurnWatcher.result());
+    });
+}
+
+void MainWindow::prepareHalfTurn()
+{
+    mHalfTurnPixmap = QPixmap();
+    mHalfTurnPage.reset();
+
+    PagePtr page = currentDoc->pages.value(currentPage);
+    QPair<DocumentPtr, int> next = pageAfter(currentDoc, currentPage);
+    if (!page || !next.first) { return; }
+
+    mHalfTurnPage = page;
+    mHalfTurnWatcher.setFuture(QtConcurrent::run(composeHalfTurn,
+            halfTurnPage(page), halfTurnPage(next.first->pages.value(next.second))));
+}
+
+bool MainWindow::showHalfTurn()
+{
+    if (!mHalfTurnPage) { return false; }
+    if (mHalfTurnPage != currentDoc->pages.value(currentPage)) { return false; }
+
+    if (mHalfTurnPixmap.isNull()) {
+        // Only when tapping faster than the composite could be prepared
+        mHalfTurnWatcher.waitForFinished();
+        mHalfTurnPixmap = QPixmap::fromImage(mHalfTurnWatcher.result());
+        if (mHalfTurnPixmap.isNull()) { return false; }
+    }
+
+    mHalfTurnItem->setPixmap(mHalfTurnPixmap);
+    mHalfTurnScene.setSceneRect(mHalfTurnItem->boundingRect());
+    ui->graphicsView->setScene(&mHalfTurnScene);
+    mHalfTurned = true;
+    scaleScene();
+    broadcastPosition();
+    return true;
+}
+
+QPair<MainWindow::DocumentPtr, int> MainWindow::pageAfter(DocumentPtr doc, int pageIndex)
+{
+    if (pageIndex + 1 < doc->pages.count()) {
+        return qMakePair(doc, pageIndex + 1);
+    }
+    // First page of next document with pages
+    for (int i = documents.indexOf(doc) + 1; i < documents.count(); i++) {
+        DocumentPtr next = documents.value(i);
+        if (next->pages.count()) { return qMakePair(next, 0); }
+    }
+    return qMakePair(DocumentPtr(), 0);
+}
+
+void MainWindow::updateResidentPages()
+{
+    // Pages near the current page (also in neighbouring documents) have their
+    // pixmaps decoded, all others are kept compressed only.
+    int currentIndex = 0;
+    int index = 0;
+    QList<PagePtr> pages;
+    foreach (DocumentPtr doc, documents.all()) {
+        if (doc == currentDoc) {
+            currentIndex = index + currentPage;
+        }
+        pages.append(doc->pages);
+        index += doc->pages.count();
+    }
+
+    for (int i = 0; i < pages.count(); i++) {
+        pages[i]->setResident(qAbs(i - currentIndex) <= mResidentPageRadius);
+    }
+
+    // Also the page a sync leader will show next
+    if (mSyncNextPage.first) {
+        PagePtr next = mSyncNextPage.first->pages.value(mSyncNextPage.second);
+        if (next) { next->setResident(true); }
+    }
+}
+
+qint64 MainWindow::decodedPageBytes()
+{
+    QSize size;
+    if (currentDoc && currentDoc->source) {
+        size = currentDoc->source->renderSize(currentDoc->pdfPages.value(currentPage));
+    }
+    if (size.isEmpty()) {
+        // A4
+        size = PdfSource::renderSizeFor(QSizeF(595, 842));
+    }
+    return (qint64)size.width() * size.height() * 4;
+}
+
+void MainWindow::setupMemoryGovernor()
+{
+    connect(&memoryGovernor, &MemoryGovernor::budgetChanged,
+            this, &MainWindow::applyMemoryBudget);
+    memoryGovernor.start();
+    // Apply the split between decoded and compressed pages also when the
+    // first sample doesn't change the budget
+    applyMemoryBudget(memoryGovernor.budget(), memoryGovernor.budget());
+}
+
+void MainWindow::applyMemoryBudget(qint64 budget, qint64 previous)
+{
+    const qint64 MB = 1024 * 1024;
+
+    // Half of the budget is for decoded pages around the current page
+    qint64 pageBytes = decodedPageBytes();
+    int radius = (int)((budget / 2 / pageBytes - 1) / 2);
+    radius = qBound(1, radius, maxResidentPageRadius);
+    mPageCacheBudget = qMax(qint64(0), budget - (2 * radius + 1) * pageBytes);
+
+    MemoryGovernor::Sample sample = memoryGovernor.lastSample();
+    print(QString("Memory: page budget %1 MB -> %2 MB (available %3 MB, process %4 MB%5)")
+          .arg(previous / MB).arg(budget / MB)
+          .arg(sample.availableBytes / MB).arg(sample.rssBytes / MB)
+          .arg((sample.limitBytes > 0)
+               ? QString(", cgroup limit %1 MB").arg(sample.limitBytes / MB)
+               : QString()));
+
+    if (radius != mResidentPageRadius) {
+        print(QString("Memory: keeping %1 pages decoded either side (was %2)")
+              .arg(radius).arg(mResidentPageRadius));
+        mResidentPageRadius = radius;
+        updateResidentPages();
+    }
+
+    if (budget > previous) {
+        // Room to render further ahead again
+        mRenderDistanceLimit = -1;
+        enforcePageCacheBudget();
+        scheduleRenders();
+    } else {
+        enforcePageCacheBudget();
+    }
+}
+
+void MainWindow::enforcePageCacheBudget()
+{
+    // Pages of all documents in order, as for updateResidentPages()
+    QList<QPair<DocumentPtr, int>> all;
+    int currentIndex = 0;
+    foreach (DocumentPtr doc, documents.all()) {
+        if (doc == currentDoc) {
+            currentIndex = all.count() + currentPage;
+        }
+        for (int i = 0; i < doc->pages.count(); i++) {
+            all.append(qMakePair(doc, i));
+        }
+    }
+
+    // Images may be shared by several pages, so an image is only dropped
+    // when all its pages are far enough
+    QHash<PageImage*, int> distances;
+    QHash<PageImage*, QList<int>> users;
+    for (int i = 0; i < all.count(); i++) {
+        PageImagePtr image = all[i].first->pages[all[i].second]->pageImage();
+        if (!image) { continue; }
+        int d = qAbs(i - currentIndex);
+        if (!distances.contains(image.data()) || (d < distances.value(image.data()))) {
+            distances.insert(image.data(), d);
+        }
+        users[image.data()].append(i);
+    }
+
+    qint64 compressed = 0;
+    qint64 decoded = 0;
+    QList<QPair<int, PageImage*>> byDistance;
+    foreach (PageImage* image, distances.keys()) {
+        compressed += image->compressedBytes();
+        if (image->isResident()) {
+            decoded += (qint64)image->size().width() * image->size().height() * 4;
+        }
+        byDistance.append(qMakePair(distances.value(image), image));
+    }
+    std::sort(byDistance.begin(), byDistance.end());
+
+    int evictedPages = 0;
+    qint64 evictedBytes = 0;
+    int nearestEvicted = -1;
+    while ((compressed > mPageCacheBudget) && !byDistance.isEmpty()) {
+        QPair<int, PageImage*> farthest = byDistance.takeLast();
+        if (farthest.first <= mResidentPageRadius) { break; }
+
+        PageImage* image = farthest.second;
+        // Decoded pages further away are in use, e.g. the sync leader's next
+        // page
+        if (image->isResident()) { continue; }
+        compressed -= image->compressedBytes();
+        evictedBytes += image->compressedBytes();
+        nearestEvicted = farthest.first;
+        foreach (int index, users.value(image)) {
+            DocumentPtr doc = all[index].first;
+            PagePtr page = doc->pages[all[index].second];
+            if (doc->source) {
+                doc->source->removePage(doc->pdfPages.value(all[index].second));
+            }
+            page->setPageImage(PageImagePtr());
+            mCompositeScene.updatePageImage(page);
+            evictedPages++;
+        }
+    }
+
+    mRenderedBytes = compressed;
+    mDecodedBytes = decoded;
+    memoryGovernor.setCacheBytes(compressed + decoded);
+
+    if (evictedPages) {
+        print(QString("Memory: dropped %1 rendered pages (%2 KB) further than %3 "
+                      "pages from the current page")
+              .arg(evictedPages).arg(evictedBytes / 1024).arg(nearestEvicted - 1));
+        int limit = qMax(mResidentPageRadius, nearestEvicted - 1);
+        if ((mRenderDistanceLimit < 0) || (limit < mRenderDistanceLimit)) {
+            // Drop queued renders past the new limit, they would only be
+            // dropped again
+            mRenderDistanceLimit = limit;
+            scheduleRenders();
+        }
+    }
+}
+
+void MainWindow::setupRenderScheduler()
+{
+    connect(&renderScheduler, &RenderScheduler::pageRendered,
+            this, &MainWindow::onPageRendered);
+}
+
+void MainWindow::scheduleRenders()
+{
+    QList<RenderScheduler::Job> jobs;
+    QSet<QPair<PdfSource*, int>> added;
+
+    auto add = [&](DocumentPtr doc, int pageIndex, RenderScheduler::Priority priority)
+    {
+        if (!doc || !doc->source) { return; }
+        PagePtr page = doc->pages.value(pageIndex);
+        if (!page || page->pageImage()) { return; }
+        int pdfPage = doc->pdfPages.value(pageIndex, -1);
+        if (pdfPage < 0) { return; }
+
+        // Documents may share pages of the same PDF
+        QPair<PdfSource*, int> key(doc->source.data(), pdfPage);
+        if (added.contains(key)) { return; }
+        added.insert(key);
+
+        RenderScheduler::Job job;
+        job.source = doc->source;
+        job.pdfPage = pdfPage;
+        job.priority = priority;
+
+        // Visible pages get a quick preview first so something is shown
+        // while the page renders
+        if ((priority == RenderScheduler::Priority::Visible) && !page->hasPreview()) {
+            RenderScheduler::Job preview = job;
+            preview.preview = true;
+            jobs.append(preview);
+        }
+        jobs.append(job);
+    };
+
+    if (currentDoc) {
+        bool multiPage = (mViewMode != ViewMode::SinglePage) && !mIsCropping && !mIsDrawing;
+        add(currentDoc, currentPage, RenderScheduler::Priority::Visible);
+        if (multiPage) {
+            // Second page of spread, below in continuous view, or the half
+            // page turn
+            add(currentDoc, currentPage + 1, RenderScheduler::Priority::Visible);
+        }
+        QPair<DocumentPtr, int> next = pageAfter(currentDoc, currentPage);
+        if (multiPage && next.first) {
+            next = pageAfter(next.first, next.second);
+        }
+        add(next.first, next.second, RenderScheduler::Priority::NextTurn);
+    }
+    add(mSyncNextPage.first, mSyncNextPage.second, RenderScheduler::Priority::NextTurn);
+
+    // All other pages, nearest to the current page first
+    QList<QPair<DocumentPtr, int>> all;
+    int currentIndex = 0;
+    foreach (DocumentPtr doc, documents.all()) {
+        for (int i = 0; i < doc->pages.count(); i++) {
+            if ((doc == currentDoc) && (i == currentPage)) {
+                currentIndex = all.count();
+            }
+            all.append(qMakePair(doc, i));
+        }
+    }
+    for (int d = 0; d < all.count(); d++) {
+        if ((mRenderDistanceLimit >= 0) && (d > mRenderDistanceLimit)) { break; }
+        RenderScheduler::Priority priority = (d <= mResidentPageRadius)
+                ? RenderScheduler::Priority::Prefetch
+                : RenderScheduler::Priority::Background;
+        foreach (int index, QList<int>({currentIndex + d, currentIndex - d})) {
+            if ((index >= 0) && (index < all.count())) {
+                add(all[index].first, all[index].second, priority);
+            }
+        }
+    }
+
+    renderScheduler.setJobs(jobs);
+}
+
+void MainWindow::onPageRendered(PdfSource* source, int pdfPage, bool preview,
+                                int priority, qint64 renderMs)
+{
+    if (preview) {
+        QImage image;
+        foreach (DocumentPtr doc, documents.all()) {
+            if (doc->source.data() != source) { continue; }
+            if (image.isNull()) {
+                image = doc->source->cachedPreview(pdfPage);
+                if (image.isNull()) { return; }
+            }
+            for (int i = 0; i < doc->pdfPages.count(); i++) {
+                if (doc->pdfPages[i] != pdfPage) { continue; }
+                PagePtr page = doc->pages.value(i);
+                if (!page) { continue; }
+                page->setPreview(image);
+                mCompositeScene.updatePageImage(page);
+            }
+        }
+        print(QString("Preview of page %1 in %2 ms").arg(pdfPage + 1).arg(renderMs));
+        return;
+    }
+
+    PageImagePtr image;
+    bool current = false;
+    QPair<DocumentPtr, int> next;
+    if (currentDoc) {
+        next = pageAfter(currentDoc, currentPage);
+    }
+
+    foreach (DocumentPtr doc, documents.all()) {
+        if (doc->source.data() != source) { continue; }
+        if (!image) {
+            image = doc->source->cachedPage(pdfPage);
+            // Render options changed while rendering
+            if (!image) { return; }
+        }
+        for (int i = 0; i < doc->pdfPages.count(); i++) {
+            if (doc->pdfPages[i] != pdfPage) { continue; }
+            PagePtr page = doc->pages.value(i);
+            if (!page) { continue; }
+            page->setPageImage(image);
+            mCompositeScene.updatePageImage(page);
+            if (((doc == currentDoc) && (i == currentPage)) || (qMakePair(doc, i) == next)) {
+                current = true;
+            }
+        }
+    }
+
+    if (current && (mViewMode == ViewMode::HalfPage) && !mHalfTurned
+            && !mIsCropping && !mIsDrawing)
+    {
+        // Half page turn composite needs the current and next page renders
+        prepareHalfTurn();
+    }
+
+    if (priority == (int)RenderScheduler::Priority::Visible) {
+        print(QString("Rendered visible page %1 in %2 ms").arg(pdfPage + 1).arg(renderMs));
+    }
+
+    if (image) {
+        mRenderedBytes += image->compressedBytes();
+        memoryGovernor.setCacheBytes(mRenderedBytes + mDecodedBytes);
+    }
+    if (mRenderedBytes > mPageCacheBudget) {
+        enforcePageCacheBudget();
+    }
+
+    if (StartupTimeline::isRunning() && currentDoc) {
+        PagePtr page = currentDoc->pages.value(currentPage);
+        if (page && page->pageImage()) {
+            finishStartupTimeline("Current page rendered");
+        }
+    }
+}
+
+void MainWindow::scaleScene()
+{
+    if (!currentDoc) {
+        // Startup snapshot, shown until the session has been read
+        if (mSnapshotPage) {
+            QRectF rect = mSnapshotPage->getPageRect();
+            ui->graphicsView->fitInView(rect, Qt::KeepAspectRatio);
+            ui->graphicsView->centerOn(rect.center());
+        }
+        return;
+    }
+    PagePtr page = currentDoc->pages.value(currentPage);
+    if (!page) { return; }
+
+    if (usesCompositeView()) {
+        scaleCompositeScene();
+        return;
+    }
+
+    if (mHalfTurned) {
+        ui->graphicsView->fitInView(mHalfTurnScene.sceneRect(), Qt::KeepAspectRatio);
+        ui->graphicsView->centerOn(mHalfTurnScene.sceneRect().center());
+        return;
+    }
+
+    QRectF rect;
+    if (mIsCropping) {
+        rect = page->imageRect();
+    } else if (mIsZoomed) {
+        rect = page->getZoomRect();
+    } else {
+        rect = page->getPageRect();
+    }
+
+    page->showCropRect(mIsCropping);
+    ui->graphicsView->fitInView(rect, Qt::KeepAspectRatio);
+    ui->graphicsView->centerOn(rect.center());
+}
+
+void MainWindow::removeDocAndShowOther(DocumentPtr doc)
+{
+    if (!doc) { return; }
+
+    int docIndex = documents.indexOf(doc);
+    documents.remove(doc);
+
+    if (documents.count()) {
+        // Show previous doc
+        if (docIndex > 0) { docIndex -= 1; }
+        viewPage(documents.value(docIndex), 0);
+    } else {
+        currentDoc.reset();
+        ui->graphicsView->setScene(nullptr);
+        mCompositeScene.clearPages();
+        mCompositeDoc.reset();
+        updateBreadcrumbs();
+    }
+}
+
+void MainWindow::removeDocument(DocumentPtr doc)
+{
+    if (!doc) { return; }
+
+    int index = documents.indexOf(doc);
+    removeDocAndShowOther(doc);
+
+    undoStack.push("Remove Document",
+                   [=]() { documents.add(doc, index); viewPage(doc, 0); },
+                   [=]() { removeDocAndShowOther(doc); },
+                   documentBytes(doc));
+}
+
+bool MainWindow::showStartupSnapshot()
+{
+    const StartupSnapshot::PageEntry* entry = mStartupSnapshot.currentPage();
+    if (!entry) { return false; }
+
+    mSnapshotPage.reset(new Page());
+    mSnapshotPage->setPageImage(entry->image);
+    mSnapshotPage->setPageRect(entry->pageRect);
+    ui->graphicsView->setScene(scenePool.sceneFor(mSnapshotPage));
+    StartupTimeline::mark("Startup snapshot shown");
+    return true;
+}
+
+void MainWindow::attachStartupSnapshotRenders()
+{
+    if (!startupSnapshotRendersUsable()) { return; }
+
+    // Show the snapshot renders on the session pages at once, before the PDFs
+    // are open. They are checked against the PDFs in
+    // useStartupSnapshotRenders() once the PDFs are open.
+    foreach (const StartupSnapshot::PageEntry& entry, mStartupSnapshot.pages) {
+        DocumentPtr doc = documents.value(entry.docIndex);
+        if (!doc) { continue; }
+        PagePtr page = doc->pages.value(entry.pageIndex);
+        if (!page || page->pageImage()) { continue; }
+        if (entry.image->size() != page->imageRect().size().toSize()) { continue; }
+        page->setPageImage(entry.image);
+    }
+}
+
+bool MainWindow::startupSnapshotRendersUsable()
+{
+    if (mStartupSnapshot.pages.isEmpty()) { return false; }
+
+    // Only renders made with the current render options can be used
+    if ((mStartupSnapshot.renderMode != settings.renderMode.value().toInt())
+            || (mStartupSnapshot.enhanceContrast != settings.enhanceContrast.value().toBool()))
+    {
+        mStartupSnapshot.pages.clear();
+        return false;
+    }
+    return true;
+}
+
+void MainWindow::saveStartupSnapshot()
+{
+    // The snapshot is only used if the session file is unchanged, so there is
+    // no use for it if the session isn't saved
+    if (mSessionFilepath.isEmpty() || mSessionModified || !currentDoc) {
+        StartupSnapshot::remove();
+        return;
+    }
+
+    StartupSnapshot snapshot;
+    snapshot.sessionFilepath = mSessionFilepath;
+    snapshot.sessionModifiedMs = QFileInfo(mSessionFilepath).lastModified().toMSecsSinceEpoch();
+    snapshot.docIndex = documents.indexOf(currentDoc);
+    snapshot.pageIndex = currentPage;
+    snapshot.renderMode = settings.renderMode.value().toInt();
+    snapshot.enhanceContrast = settings.enhanceContrast.value().toBool();
+
+    // Renders of the current page and its neighbours
+    QList<QPair<DocumentPtr, int>> positions;
+    positions.append(qMakePair(currentDoc, currentPage - 1));
+    positions.append(qMakePair(currentDoc, currentPage));
+    positions.append(pageAfter(currentDoc, currentPage));
+    for (int i = 0; i < positions.count(); i++) {
+        DocumentPtr doc = positions[i].first;
+        int pageIndex = positions[i].second;
+        if (!doc || !doc->source) { continue; }
+        PagePtr page = doc->pages.value(pageIndex);
+        if (!page || !page->pageImage()) { continue; }
+
+        StartupSnapshot::PageEntry entry;
+        entry.docIndex = documents.indexOf(doc);
+        entry.pageIndex = pageIndex;
+        entry.contentHash = doc->source->contentHash();
+        entry.pdfPage = doc->pdfPages.value(pageIndex, -1);
+        entry.pageRect = page->getPageRect();
+        entry.image = page->pageImage();
+        snapshot.pages.append(entry);
+    }
 
-    QRectF rect;
-    if (mIsCropping) {
-        rect = page->mPixmap->boundingRect();
-    } else if (mIsZoomed) {
-        rect = page->getZoomRect();
+    if (snapshot.pages.isEmpty()) {
+        StartupSnapshot::remove();
     } else {
-        rect = page->getPageRect();
+        snapshot.save();
     }
-
-    page->showCropRect(mIsCropping);
-    ui->graphicsView->fitInView(rect, Qt::KeepAspectRatio);
-    ui->graphicsView->centerOn(rect.center());
 }
 
-void MainWindow::removeDocAndShowOther(DocumentPtr doc)
+void MainWindow::useStartupSnapshotRenders(DocumentPtr doc)
 {
-    if (!doc) { return; }
+    if (!doc->source || !startupSnapshotRendersUsable()) { return; }
 
     int docIndex = documents.indexOf(doc);
-    documents.remove(doc);
-
-    if (documents.count()) {
-        // Show previous doc
-        if (docIndex > 0) { docIndex -= 1; }
-        viewPage(documents.value(docIndex), 0);
-    } else {
-        currentDoc.reset();
-        ui->graphicsView->setScene(nullptr);
-        updateBreadcrumbs();
+    for (int i = mStartupSnapshot.pages.count() - 1; i >= 0; i--) {
+        StartupSnapshot::PageEntry entry = mStartupSnapshot.pages[i];
+        if (entry.docIndex != docIndex) { continue; }
+        mStartupSnapshot.pages.removeAt(i);
+
+        // Only if the page is still from the same PDF page
+        PagePtr page = doc->pages.value(entry.pageIndex);
+        if (!page || entry.contentHash.isEmpty()
+                || (entry.contentHash != doc->source->contentHash())
+                || (entry.pdfPage != doc->pdfPages.value(entry.pageIndex, -1))
+                || (entry.image->size() != doc->source->renderSize(entry.pdfPage)))
+        {
+            continue;
+        }
+        // The page image is set from the source by loadPdf()
+        doc->source->insertPage(entry.pdfPage, entry.image);
+        mRenderedBytes += entry.image->compressedBytes();
     }
+}
 
-    setSessionModified(true);
+void MainWindow::onFirstFrame()
+{
+    if (!mDeferredSession.isEmpty()) {
+        QString filepath = mDeferredSession;
+        mDeferredSession.clear();
+        openSession(filepath);
+    } else if (!currentDoc) {
+        finishStartupTimeline("No session");
+    }
 }
 
-QJsonObject MainWindow::rectToJson(QRectF rect)
+void MainWindow::finishStartupTimeline(QString event)
 {
-    QJsonObject obj;
-    obj.insert("xTopLeft", rect.topLeft().x());
-    obj.insert("yTopLeft", rect.topLeft().y());
-    obj.insert("xBotRight", rect.bottomRight().x());
-    obj.insert("yBotRight", rect.bottomRight().y());
-    return obj;
+    if (!StartupTimeline::isRunning()) { return; }
+
+    StartupTimeline::mark(event);
+    StartupTimeline::finish();
+    print("Startup timeline:");
+    foreach (QString line, StartupTimeline::lines()) {
+        print("    " + line);
+    }
 }
 
-QRectF MainWindow::jsonToRect(QJsonObject obj)
+bool MainWindow::eventFilter(QObject* watched, QEvent* event)
 {
-    QRectF rect(
-                QPointF(obj.value("xTopLeft").toDouble(),
-                        obj.value("yTopLeft").toDouble()),
-                QPointF(obj.value("xBotRight").toDouble(),
-                        obj.value("yBotRight").toDouble()));
-    return rect;
+    if (!mFirstFrameShown && (watched == ui->graphicsView->viewport())
+            && (event->type() == QEvent::Paint))
+    {
+        mFirstFrameShown = true;
+        ui->graphicsView->viewport()->removeEventFilter(this);
+        StartupTimeline::mark("First frame");
+        print(QString("Time to first frame: %1 ms").arg(StartupTimeline::elapsedMs()));
+        // Continue once this frame has been painted
+        QTimer::singleShot(0, this, &MainWindow::onFirstFrame);
+    }
+    return QMainWindow::eventFilter(watched, event);
 }
 
 void MainWindow::clearSession()
 {
+    mLoadGeneration++;
+    mSnapshotPage.reset();
+    mDeferredSession.clear();
     currentDoc.reset();
     currentPage = 0;
     documents.clear();
+    undoStack.clear();
+    renderScheduler.cancelAll();
     ui->graphicsView->setScene(nullptr);
+    scenePool.unbindAll();
+    mCompositeScene.clearPages();
+    mCompositeDoc.reset();
+    mRenderDistanceLimit = -1;
+    mRenderedBytes = 0;
+    mDecodedBytes = 0;
+    mSyncNextPage = QPair<DocumentPtr, int>();
     updateBreadcrumbs();
     setSessionModified(false);
     setSessionFilepath("");
 }
 
-void MainWindow::loadPdf(DocumentPtr doc)
+void MainWindow::resolveFilepath(DocumentPtr doc)
 {
-    if (!doc) { return; }
-
     QString filepath = doc->filepath;
 
     QFileInfo fi(filepath);
@@ -480,58 +1506,123 @@ void MainWindow::loadPdf(DocumentPtr doc)
         }
     }
 
-    QPdfDocument pdf;
+    doc->resolvedFilepath = filepath;
+}
+
+void MainWindow::loadPdf(DocumentPtr doc)
+{
+    if (!doc) { return; }
+
+    resolveFilepath(doc);
+    QString filepath = doc->resolvedFilepath;
+
+    // Documents referring to the same file share the open PDF and its renders
     print("Loading " + filepath);
-    QPdfDocument::DocumentError error = pdf.load(filepath);
-    print(QString("Load result: %1").arg(QVariant::fromValue(error).toString()));
+    PdfSourcePtr pdf = pdfRegistry.open(filepath);
+    doc->source = pdf;
+    print(QString("Load result: %1").arg(QVariant::fromValue(pdf->error()).toString()));
 
-    print(QString("Pages: %1").arg(pdf.pageCount()));
-    for (int i=0; i < pdf.pageCount(); i++) {
-        QSizeF size = pdf.pageSize(i);
+    // Only the pages in the document's page range are sized and rendered
+    doc->pdfPages = pdf->pagesInRange(doc->pageRange);
+
+    // Startup snapshot renders first, so a snapshot render already shown on a
+    // page (see attachStartupSnapshotRenders()) is replaced by itself
+    useStartupSnapshotRenders(doc);
+
+    print(QString("Pages: %1 of %2").arg(doc->pdfPages.count()).arg(pdf->pageCount()));
+    for (int i=0; i < doc->pdfPages.count(); i++) {
+        int pdfPage = doc->pdfPages[i];
+        QSizeF size = pdf->pageSize(pdfPage);
         print(QString("    %1: %2x%3")
-              .arg(i)
+              .arg(pdfPage)
               .arg(size.width()).arg(size.height()));
 
-        QImage im = pdf.render(i, size.toSize() * 2);
-        PageScenePtr page = doc->pages.value(i);
+        PagePtr page = doc->pages.value(i);
         if (!page) {
             print("Page doesn't exist, creating new");
-            page.reset(new PageScene());
+            page.reset(new Page());
             doc->pages.append(page);
         }
-        page->setImage(im);
+        // Geometry is known before the page is rendered (see scheduleRenders())
+        page->setImageSize(pdf->renderSize(pdfPage));
+        page->setPageImage(pdf->cachedPage(pdfPage));
     }
 }
 
-bool MainWindow::writeSession(QString filepath)
+void MainWindow::loadPdfs(QList<DocumentPtr> docs, std::function<void()> loaded)
 {
-    QJsonArray jdocs;
-    foreach (DocumentPtr doc, documents.all()) {
-        QJsonObject jdoc;
-        jdoc.insert("name", doc->name);
-        jdoc.insert("filepath", doc->filepath);
+    if (docs.isEmpty()) { return; }
 
-        QJsonArray jpages;
-        foreach (PageScenePtr page, doc->pages) {
-            QJsonObject jpage;
-            jpage.insert("rect", rectToJson(page->getCropRect()));
+    QStringList filepaths;
+    foreach (DocumentPtr doc, docs) {
+        resolveFilepath(doc);
+        filepaths.append(doc->resolvedFilepath);
+    }
+    filepaths = pdfRegistry.unopened(filepaths);
 
-            QJsonArray jcurves;
-            foreach (DrawCurvePtr c, page->drawCurves()) {
-                jcurves.append(c->toJson());
-            }
-            jpage.insert("drawCurves", jcurves);
+    int generation = mLoadGeneration;
+    QElapsedTimer timer;
+    timer.start();
+
+    typedef QList<PdfRegistry::Prepared> PreparedList;
+    QFutureWatcher<PreparedList>* watcher = new QFutureWatcher<PreparedList>(this);
+    connect(watcher, &QFutureWatcher<PreparedList>::finished, this, [=]()
+    {
+        watcher->deleteLater();
+        if (generation != mLoadGeneration) { return; }
+
+        PreparedList prepared = watcher->result();
+        print(QString("Opened %1 PDF files in %2 ms")
+              .arg(prepared.count()).arg(timer.elapsed()));
+        pdfRegistry.add(prepared);
+        foreach (DocumentPtr doc, docs) {
+            loadPdf(doc);
+        }
+        StartupTimeline::mark(QString("Opened %1 PDF files").arg(prepared.count()));
+        if (loaded) {
+            loaded();
+            return;
+        }
+
+        // Update geometry and start rendering
+        if (!currentDoc) { return; }
+        mCompositeDoc.reset();
+        viewPage(currentDoc, currentPage);
 
-            jpages.append(jpage);
+        PagePtr page = currentDoc->pages.value(currentPage);
+        if (page && page->pageImage()) {
+            finishStartupTimeline("Current page shown from startup snapshot render");
         }
-        jdoc.insert("pages", jpages);
+    });
+    watcher->setFuture(QtConcurrent::run(&PdfRegistry::prepare, filepaths));
+}
 
-        jdocs.append(jdoc);
+bool MainWindow::writeSession(QString filepath)
+{
+    // Snapshot of the documents, converted to JSON in parallel
+    QList<SessionWriter::DocumentSnapshot> snapshot;
+    foreach (DocumentPtr doc, documents.all()) {
+        SessionWriter::DocumentSnapshot sdoc;
+        sdoc.name = doc->name;
+        sdoc.filepath = doc->filepath;
+        sdoc.pageRange = doc->pageRange;
+        foreach (PagePtr page, doc->pages) {
+            SessionWriter::PageSnapshot spage;
+            spage.cropRect = page->getCropRect();
+            spage.size = page->imageRect().size() / PdfSource::renderScale;
+            foreach (DrawCurvePtr c, page->drawCurves()) {
+                spage.curves.append(c->painterPath());
+            }
+            sdoc.pages.append(spage);
+        }
+        snapshot.append(sdoc);
     }
 
-    QJsonDocument jout;
-    jout.setArray(jdocs);
-    QByteArray json = jout.toJson();
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray json = SessionWriter::toJson(snapshot);
+    print(QString("Serialized %1 documents in %2 ms")
+          .arg(snapshot.count()).arg(timer.elapsed()));
 
     GidFile::Result r = GidFile::write(filepath, json);
     if (r.success) {
@@ -567,12 +1658,74 @@ void MainWindow::setSessionFilepath(QString path)
 {
     mSessionFilepath = path;
     updateWindowTitle();
+    syncLink.sendSession(path);
 }
 
 void MainWindow::setSessionModified(bool modified)
 {
     mSessionModified = modified;
     updateWindowTitle();
+
+    if (modified) {
+        undoStack.resetClean();
+    } else {
+        undoStack.setClean();
+    }
+}
+
+void MainWindow::setupUndo()
+{
+    undoStack.setMemoryLimit(undoMemoryLimit);
+
+    connect(&undoStack, &UndoStack::changed, this, [=]()
+    {
+        ui->action_Undo->setEnabled(undoStack.canUndo());
+        ui->action_Undo->setToolTip("Undo " + undoStack.undoText());
+        ui->action_Redo->setEnabled(undoStack.canRedo());
+        ui->action_Redo->setToolTip("Redo " + undoStack.redoText());
+
+        bool modified = !undoStack.isClean();
+        if (modified != mSessionModified) {
+            mSessionModified = modified;
+            updateWindowTitle();
+        }
+    });
+
+    ui->action_Undo->setEnabled(false);
+    ui->action_Redo->setEnabled(false);
+}
+
+void MainWindow::pushPageEdit(QString text, DocumentPtr doc, int pageIndex,
+                              UndoStack::Action undo, UndoStack::Action redo,
+                              qint64 bytes)
+{
+    auto showPage = [=](UndoStack::Action action)
+    {
+        return [=]()
+        {
+            action();
+            // Show the changed page, rebuilding composite views
+            if (documents.indexOf(doc) >= 0) {
+                mCompositeDoc.reset();
+                viewPage(doc, pageIndex);
+            }
+        };
+    };
+    undoStack.push(text, showPage(undo), showPage(redo), bytes);
+}
+
+qint64 MainWindow::documentBytes(DocumentPtr doc)
+{
+    qint64 bytes = 0;
+    foreach (PagePtr page, doc->pages) {
+        if (page->pageImage()) {
+            bytes += page->pageImage()->compressedBytes();
+        }
+        foreach (DrawCurvePtr curve, page->drawCurves()) {
+            bytes += curve->memoryBytes();
+        }
+    }
+    return bytes;
 }
 
 void MainWindow::updateDocOrderList_added(DocumentPtr doc, int index)
@@ -580,7 +1733,7 @@ void MainWindow::updateDocOrderList_added(DocumentPtr doc, int index)
     QListWidgetItem* item = new QListWidgetItem();
     item->setData(Qt::UserRole, doc->name);
     ui->listWidget_docs->insertItem(index, item);
-    updateDocOrderListIndexes();
+    updateDocOrderListIndexes(index);
 }
 
 void MainWindow::updateDocOrderList_cleared()
@@ -593,7 +1746,7 @@ void MainWindow::updateDocOrderList_removed(int index)
     QListWidgetItem* item = ui->listWidget_docs->item(index);
     if (item) {
         delete item;
-        updateDocOrderListIndexes();
+        updateDocOrderListIndexes(index);
     }
 }
 
@@ -603,12 +1756,26 @@ void MainWindow::updateDocOrderList_moved(int from, int to)
     if (!item) { return; }
 
     ui->listWidget_docs->insertItem(to, item);
+    updateDocOrderListIndexes(qMin(from, to));
+}
+
+void MainWindow::updateDocOrderList_reset()
+{
+    ui->listWidget_docs->setUpdatesEnabled(false);
+    ui->listWidget_docs->clear();
+    foreach (DocumentPtr doc, documents.all()) {
+        QListWidgetItem* item = new QListWidgetItem();
+        item->setData(Qt::UserRole, doc->name);
+        ui->listWidget_docs->addItem(item);
+    }
     updateDocOrderListIndexes();
+    ui->listWidget_docs->setUpdatesEnabled(true);
 }
 
-void MainWindow::updateDocOrderListIndexes()
+void MainWindow::updateDocOrderListIndexes(int from)
 {
-    for (int i = 0; i < ui->listWidget_docs->count(); i++) {
+    // Only items from the given index onwards have changed numbers
+    for (int i = from; i < ui->listWidget_docs->count(); i++) {
         QListWidgetItem* item = ui->listWidget_docs->item(i);
         item->setText(QString("%1 - %2")
                       .arg(i+1)
@@ -647,6 +1814,172 @@ void MainWindow::updateBreadcrumbs()
     ui->widget_pagesBreadcrumbs->setBounds(pageCount, currentPage);
 }
 
+QString MainWindow::onExternalCommand(CommandServer::Command command)
+{
+    DocumentPtr doc = currentDoc;
+    if (command.type == CommandServer::Command::Type::Document) {
+        doc = documents.value(command.doc);
+        if (!doc) {
+            return QString("no document %1, session has %2")
+                    .arg(command.doc + 1).arg(documents.count());
+        }
+    }
+    if ((command.type == CommandServer::Command::Type::Page)
+            || (command.type == CommandServer::Command::Type::Document))
+    {
+        if (!doc) { return "no document shown"; }
+        if (command.page >= doc->pages.count()) {
+            return QString("no page %1, document has %2")
+                    .arg(command.page + 1).arg(doc->pages.count());
+        }
+    }
+
+    switch (command.type) {
+    case CommandServer::Command::Type::Next:
+        on_action_Next_Page_triggered();
+        break;
+    case CommandServer::Command::Type::Previous:
+        on_action_Previous_Page_triggered();
+        break;
+    case CommandServer::Command::Type::Page:
+    case CommandServer::Command::Type::Document:
+        viewPage(doc, command.page);
+        break;
+    }
+
+    // Scale and paint now instead of in a later event loop pass
+    if (ui->stackedWidget->currentWidget() == ui->page_main) {
+        scaleScene();
+        ui->graphicsView->viewport()->repaint();
+    }
+
+    qint64 latencyNs = commandServer.elapsedNs() - command.receivedNs;
+    print(QString("Command (%1) handled in %2 us")
+          .arg(command.source).arg(latencyNs / 1000.0, 0, 'f', 1));
+    return QString();
+}
+
+void MainWindow::startSync(SyncLink::Role role, QString name)
+{
+    if (role == SyncLink::Role::Leader) {
+        if (syncLink.startLeader(name)) {
+            print("Sync leader on local socket " + name);
+        } else {
+            print("Sync: could not listen on local socket " + name + ": "
+                  + syncLink.errorString());
+        }
+        syncLink.sendSession(mSessionFilepath);
+        broadcastPosition();
+    } else if (role == SyncLink::Role::Follower) {
+        connect(&syncLink, &SyncLink::sessionReceived,
+                this, &MainWindow::onSyncSession);
+        connect(&syncLink, &SyncLink::positionReceived,
+                this, &MainWindow::onSyncPosition);
+        syncLink.startFollower(name);
+        print("Sync follower of local socket " + name);
+    }
+}
+
+void MainWindow::broadcastPosition()
+{
+    if (syncLink.role() != SyncLink::Role::Leader) { return; }
+
+    SyncLink::Position position;
+    if (currentDoc) {
+        position.doc = documents.indexOf(currentDoc);
+        position.page = currentPage;
+        position.halfTurned = mHalfTurned;
+        PagePtr page = currentDoc->pages.value(currentPage);
+        if (mIsZoomed && page) {
+            position.zoomed = true;
+            position.zoomRect = page->getZoomRect();
+        }
+        QPair<DocumentPtr, int> next = pageAfter(currentDoc, currentPage);
+        if (next.first) {
+            position.nextDoc = documents.indexOf(next.first);
+            position.nextPage = next.second;
+        }
+    }
+    syncLink.sendPosition(position);
+}
+
+bool MainWindow::isSyncedSession()
+{
+    if (mSyncSession.isEmpty()) { return false; }
+    return QFileInfo(mSyncSession).canonicalFilePath()
+            == QFileInfo(mSessionFilepath).canonicalFilePath();
+}
+
+void MainWindow::onSyncSession(QString filepath)
+{
+    mSyncSession = filepath;
+    if (!isSyncedSession()) {
+        print("Sync: not following, leader session differs: " + filepath);
+    }
+}
+
+void MainWindow::onSyncPosition(SyncLink::Position position)
+{
+    if (!isSyncedSession()) { return; }
+
+    DocumentPtr doc = documents.value(position.doc);
+    if (!doc) { return; }
+    PagePtr page = doc->pages.value(position.page);
+    if (!page) { return; }
+
+    // Have the page the leader will most likely show next ready. Set before
+    // viewPage(), which schedules the renders.
+    QPair<DocumentPtr, int> next(documents.value(position.nextDoc), position.nextPage);
+    if (!next.first || !next.first->pages.value(next.second)) {
+        next = QPair<DocumentPtr, int>();
+    }
+    bool nextChanged = (next != mSyncNextPage);
+    mSyncNextPage = next;
+
+    if ((doc != currentDoc) || (position.page != currentPage) || mHalfTurned) {
+        viewPage(doc, position.page);
+    } else if (nextChanged) {
+        updateResidentPages();
+        scheduleRenders();
+    }
+
+    if (position.zoomed) {
+        page->setZoomRect(position.zoomRect);
+        mIsZoomed = true;
+    } else {
+        unZoom();
+    }
+
+    if (position.halfTurned) {
+        showHalfTurn();
+    }
+
+    // Scale and paint now instead of in a later event loop pass
+    if (ui->stackedWidget->currentWidget() == ui->page_main) {
+        scaleScene();
+        ui->graphicsView->viewport()->repaint();
+    }
+
+    qint64 latencyNs = SyncLink::timestampNs() - position.sentNs;
+    print(QString("Sync: page %1-%2 shown %3 us after leader")
+          .arg(position.doc + 1).arg(position.page + 1)
+          .arg(latencyNs / 1000.0, 0, 'f', 1));
+}
+
+void MainWindow::setupThumbnails()
+{
+    thumbnailCache.reset(new ThumbnailCache());
+    ui->widget_thumbnails->setThumbnailCache(thumbnailCache.data());
+
+    connect(ui->widget_thumbnails, &ThumbnailsWidget::itemClicked,
+            this, [=](int index)
+    {
+        if ((index < 0) || (index >= mThumbnailPages.count())) { return; }
+        viewPage(mThumbnailPages[index].first, mThumbnailPages[index].second);
+        showMainPagesView();
+    });
+}
+
 void MainWindow::onGraphicsViewLeftClick(QPointF pos)
 {
     if (mIsCropping) { return; }
@@ -665,7 +1998,7 @@ void MainWindow::onGraphicsViewLeftMouseDragStart(QPointF pos)
     mGraphicsViewLeftMouseDown = true;
 
     if (!currentDoc) { return; }
-    PageScenePtr page = currentDoc->pages.value(currentPage);
+    PagePtr page = currentDoc->pages.value(currentPage);
     if (!page) { return; }
 
     if (mIsCropping) {
@@ -695,6 +2028,7 @@ void MainWindow::onGraphicsViewLeftMouseDragStart(QPointF pos)
 
         mSelrectEdge = edge;
         mSelStart = pos;
+        mCropStartRect = selrect;
 
     } else if (mIsZooming) {
 
@@ -706,9 +2040,9 @@ void MainWindow::onGraphicsViewLeftMouseDragStart(QPointF pos)
         mDrawCurve->addPoint(pos);
 
         if (mDrawMode == DrawMode::Pen) {
-            page->addDrawCurve(mDrawCurve);
-            setSessionModified(true);
+            page->beginDrawCurve(mDrawCurve);
         }
+        mErasedCurves.clear();
 
     }
 }
@@ -718,7 +2052,7 @@ void MainWindow::onGraphicsViewLeftMouseDrag(QPointF pos)
     if (!mGraphicsViewLeftMouseDown) { return; }
 
     if (!currentDoc) { return; }
-    PageScenePtr page = currentDoc->pages.value(currentPage);
+    PagePtr page = currentDoc->pages.value(currentPage);
     if (!page) { return; }
 
     if (mIsCropping) {
@@ -748,7 +2082,6 @@ void MainWindow::onGraphicsViewLeftMouseDrag(QPointF pos)
             break;
         }
         page->setCropRect(rect);
-        setSessionModified(true);
 
         mSelStart = pos;
 
@@ -766,13 +2099,11 @@ void MainWindow::onGraphicsViewLeftMouseDrag(QPointF pos)
 
         mDrawCurve->addPoint(pos);
 
-        if (mDrawMode == DrawMode::Pen) {
-            setSessionModified(true);
-        } else if (mDrawMode == DrawMode::Erase) {
+        if (mDrawMode == DrawMode::Erase) {
             foreach (DrawCurvePtr c, page->drawCurves()) {
                 if (mDrawCurve->intersects(c.data())) {
                     page->removeDrawCurve(c);
-                    setSessionModified(true);
+                    mErasedCurves.append(c);
                 }
             }
         }
@@ -783,7 +2114,7 @@ void MainWindow::onGraphicsViewLeftMouseDrag(QPointF pos)
 void MainWindow::onGraphicsViewLeftMouseDragEnd(QPointF /*pos*/)
 {
     if (!currentDoc) { return; }
-    PageScenePtr page = currentDoc->pages.value(currentPage);
+    PagePtr page = currentDoc->pages.value(currentPage);
     if (!page) { return; }
 
     mGraphicsViewLeftMouseDown = false;
@@ -794,13 +2125,66 @@ void MainWindow::onGraphicsViewLeftMouseDragEnd(QPointF /*pos*/)
 
         mIsZoomed = true;
         scaleScene();
+        broadcastPosition();
 
         setDrawPen();
+
+    } else if (mIsCropping) {
+
+        QRectF oldRect = mCropStartRect;
+        QRectF newRect = page->getCropRect();
+        if (newRect != oldRect) {
+            auto setRect = [=](QRectF rect)
+            {
+                page->setCropRect(rect);
+                if (!mIsCropping) { page->setPageRectToCropRect(); }
+            };
+            pushPageEdit("Crop", currentDoc, currentPage,
+                         [=]() { setRect(oldRect); },
+                         [=]() { setRect(newRect); },
+                         2 * sizeof(QRectF));
+        }
+
+    } else if (mIsDrawing) {
+
+        // Finished stroke is moved to the page's annotation overlay
+        page->endDrawCurve();
+
+        if ((mDrawMode == DrawMode::Pen) && mDrawCurve) {
+            DrawCurvePtr curve = mDrawCurve;
+            pushPageEdit("Draw", currentDoc, currentPage,
+                         [=]() { page->removeDrawCurve(curve); },
+                         [=]() { page->addDrawCurve(curve); },
+                         curve->memoryBytes());
+        } else if ((mDrawMode == DrawMode::Erase) && !mErasedCurves.isEmpty()) {
+            QList<DrawCurvePtr> erased = mErasedCurves;
+            mErasedCurves.clear();
+            qint64 bytes = 0;
+            foreach (DrawCurvePtr curve, erased) {
+                bytes += curve->memoryBytes();
+            }
+            auto restore = [=]()
+            {
+                foreach (DrawCurvePtr curve, erased) {
+                    page->addDrawCurve(curve);
+                }
+            };
+            auto erase = [=]()
+            {
+                foreach (DrawCurvePtr curve, erased) {
+                    page->removeDrawCurve(curve);
+                }
+            };
+            pushPageEdit("Erase", currentDoc, currentPage, restore, erase, bytes);
+        }
+        mDrawCurve.reset();
+
     }
 }
 
 void MainWindow::onGraphicsViewResized()
 {
+    mScrollToCurrentPage = true;
     scaleScene();
 }
 
@@ -817,7 +2201,23 @@ void MainWindow::on_action_Next_Page_triggered()
 {
     if (!currentDoc) { return; }
 
+    if (usesCompositeView() && (mViewMode == ViewMode::Continuous)) {
+        // Scroll by half a screen, so the bottom half stays visible at the top
+        if (scrollComposite(0.5)) { return; }
+    }
+
+    if ((mViewMode == ViewMode::HalfPage) && !mIsCropping && !mIsDrawing) {
+        // First tap shows the half turn, second tap the next page
+        if (!mHalfTurned && showHalfTurn()) { return; }
+    }
+
     int ipage = currentPage + 1;
+    if (usesCompositeView() && (mViewMode == ViewMode::Continuous)) {
+        // At end of scrolled document
+        ipage = currentDoc->pages.count();
+    } else if (usesCompositeView() && (mViewMode == ViewMode::TwoPages)) {
+        ipage = currentPage + 2;
+    }
     if (ipage >= currentDoc->pages.count()) {
         // End of document. Go to next.
         DocumentPtr doc = documents.value(documents.indexOf(currentDoc) + 1);
@@ -832,12 +2232,32 @@ void MainWindow::on_action_Previous_Page_triggered()
 {
     if (!currentDoc) { return; }
 
+    if (usesCompositeView() && (mViewMode == ViewMode::Continuous)) {
+        if (scrollComposite(-0.5)) { return; }
+    }
+
+    if (mHalfTurned) {
+        // Back to the whole current page
+        viewPage(currentDoc, currentPage);
+        return;
+    }
+
     int ipage = currentPage - 1;
+    bool twoPages = usesCompositeView() && (mViewMode == ViewMode::TwoPages);
+    if (usesCompositeView() && (mViewMode == ViewMode::Continuous)) {
+        // At start of scrolled document
+        ipage = -1;
+    } else if (twoPages) {
+        // Go back a spread, or to the first page if only one page before
+        ipage = (currentPage > 0) ? qMax(0, currentPage - 2) : -1;
+    }
     if (ipage < 0) {
         // Start of document. Go to previous.
         DocumentPtr doc = documents.value(documents.indexOf(currentDoc) - 1);
         if (!doc) { return; }
-        viewPage(doc, doc->pages.count() - 1);
+        int last = doc->pages.count() - 1;
+        if (twoPages) { last = qMax(0, last - 1); }
+        viewPage(doc, last);
     } else {
         viewPage(currentDoc, ipage);
     }
@@ -856,6 +2276,26 @@ void MainWindow::on_action_Add_Document_triggered()
                                                      QString(), "PDF (*.pdf)");
     if (filepaths.isEmpty()) { return; }
 
+    addDocuments(filepaths);
+}
+
+void MainWindow::on_action_Add_Document_Pages_triggered()
+{
+    QString filepath = QFileDialog::getOpenFileName(this, "Add Document Pages",
+                                                    QString(), "PDF (*.pdf)");
+    if (filepath.isEmpty()) { return; }
+
+    bool ok = false;
+    QString range = QInputDialog::getText(this, "Add Document Pages",
+                        "Pages to add (e.g. 1-3, 7):", QLineEdit::Normal,
+                        QString(), &ok);
+    if (!ok || range.trimmed().isEmpty()) { return; }
+
+    addDocuments({filepath}, range.trimmed());
+}
+
+void MainWindow::addDocuments(QStringList filepaths, QString pageRange)
+{
     // Docs will be added after current/select document
     int index = 0;
     if (ui->stackedWidget->currentWidget() == ui->page_orderDocs) {
@@ -864,21 +2304,48 @@ void MainWindow::on_action_Add_Document_triggered()
         index = documents.indexOf(currentDoc) + 1;
     }
 
-    DocumentPtr docToView;
-
+    QList<DocumentPtr> docs;
     foreach (QString filepath, filepaths) {
         DocumentPtr doc(new Document());
         doc->name = QFileInfo(filepath).baseName();
+        if (!pageRange.isEmpty()) {
+            doc->name += QString(" (p. %1)").arg(pageRange);
+        }
         doc->filepath = filepath;
-        documents.add(doc, index++);
-        updateBreadcrumbs();
-        loadPdf(doc);
-        // View the first added document
-        if (!docToView) { docToView = doc; }
+        doc->pageRange = pageRange;
+        docs.append(doc);
     }
 
-    viewPage(docToView, 0);
-    setSessionModified(true);
+    // The PDFs are opened (and hashed) in the background. The documents are
+    // added once their pages are known.
+    loadPdfs(docs, [=]()
+    {
+        int insertIndex = qMin(index, documents.count());
+        DocumentPtr docToView;
+        QStringList rejected;
+
+        documents.beginBatch();
+        foreach (DocumentPtr doc, docs) {
+            // Don't add documents without pages, e.g. for a range past the end
+            if (doc->pdfPages.isEmpty()) {
+                rejected.append(doc->name);
+                continue;
+            }
+            documents.add(doc, insertIndex++);
+            // View the first added document
+            if (!docToView) { docToView = doc; }
+        }
+        documents.endBatch();
+
+        if (!rejected.isEmpty()) {
+            QMessageBox::warning(this, "Add Documents",
+                                 "No pages to add for:\n" + rejected.join("\n"));
+        }
+        if (!docToView) { return; }
+
+        viewPage(docToView, 0);
+        setSessionModified(true);
+    });
 }
 
 void MainWindow::on_action_Save_Session_triggered()
@@ -911,6 +2378,7 @@ void MainWindow::closeEvent(QCloseEvent* event)
 {
     if (msgBoxYesNo("Quit", "Are you sure you want to quit?")) {
         if (canSessionBeClosed()) {
+            saveStartupSnapshot();
             event->accept();
         } else {
             event->ignore();
@@ -928,7 +2396,7 @@ void MainWindow::on_action_Remove_Document_triggered()
         return;
     }
 
-    removeDocAndShowOther(currentDoc);
+    removeDocument(currentDoc);
 }
 
 void MainWindow::on_action_New_Session_triggered()
@@ -947,6 +2415,27 @@ void MainWindow::on_stackedWidget_currentChanged(int /*arg1*/)
 {
     ui->action_Settings->setChecked(
                 ui->stackedWidget->currentWidget() == ui->page_settings);
+    ui->action_Thumbnails->setChecked(
+                ui->stackedWidget->currentWidget() == ui->page_thumbnails);
+
+    initPage(ui->stackedWidget->currentWidget());
+
+    if (thumbnailCache && (ui->stackedWidget->currentWidget() != ui->page_thumbnails)) {
+        // Don't keep rendering thumbnails that are not being looked at
+        thumbnailCache->cancelPending();
+    }
+}
+
+void MainWindow::initPage(QWidget* page)
+{
+    if (mInitialisedPages.contains(page)) { return; }
+    mInitialisedPages.insert(page);
+
+    if (page == ui->page_about) {
+        updateAboutPage();
+    } else if (page == ui->page_thumbnails) {
+        setupThumbnails();
+    }
 }
 
 void MainWindow::on_action_Draw_triggered()
@@ -959,6 +2448,8 @@ void MainWindow::on_action_Draw_triggered()
     showOnlyToolbar(ui->toolBar_draw);
     ui->stackedWidget->setCurrentWidget(ui->page_main);
     setDrawPen();
+    // Drawing is done in the single page view
+    viewPage(currentDoc, currentPage);
 }
 
 void MainWindow::on_action_Exit_Draw_Mode_triggered()
@@ -968,6 +2459,9 @@ void MainWindow::on_action_Exit_Draw_Mode_triggered()
 
     mIsDrawing = false;
     showOnlyToolbar(ui->toolBar_main);
+    // Rebuild composite view with the new drawings
+    mCompositeDoc.reset();
+    viewPage(currentDoc, currentPage);
 }
 
 void MainWindow::on_action_Pen_triggered()
@@ -990,8 +2484,10 @@ void MainWindow::Documents::add(DocumentPtr doc, int index)
     if (index == -1) { index = documents.count(); }
 
     documents.insert(index, doc);
-    mw->updateDocOrderList_added(doc, index);
-    mw->updateBreadcrumbs();
+    if (notify()) {
+        mw->updateDocOrderList_added(doc, index);
+        mw->updateBreadcrumbs();
+    }
 }
 
 QList<MainWindow::DocumentPtr> MainWindow::Documents::all()
@@ -1007,8 +2503,10 @@ MainWindow::DocumentPtr MainWindow::Documents::value(int index)
 void MainWindow::Documents::clear()
 {
     documents.clear();
-    mw->updateDocOrderList_cleared();
-    mw->updateBreadcrumbs();
+    if (notify()) {
+        mw->updateDocOrderList_cleared();
+        mw->updateBreadcrumbs();
+    }
 }
 
 int MainWindow::Documents::count()
@@ -1026,8 +2524,10 @@ void MainWindow::Documents::remove(DocumentPtr doc)
     int index = documents.indexOf(doc);
     if (index >= 0) {
         documents.removeAt(index);
-        mw->updateDocOrderList_removed(index);
-        mw->updateBreadcrumbs();
+        if (notify()) {
+            mw->updateDocOrderList_removed(index);
+            mw->updateBreadcrumbs();
+        }
     }
 }
 
@@ -1039,8 +2539,38 @@ void MainWindow::Documents::move(int from, int to)
     if (to >= documents.count()) { to = 0; }
 
     documents.move(from, to);
-    mw->updateDocOrderList_moved(from, to);
-    mw->updateBreadcrumbs();
+    if (notify()) {
+        mw->updateDocOrderList_moved(from, to);
+        mw->updateBreadcrumbs();
+    }
+}
+
+void MainWindow::Documents::beginBatch()
+{
+    mBatchDepth++;
+}
+
+void MainWindow::Documents::endBatch()
+{
+    if (mBatchDepth <= 0) { return; }
+    mBatchDepth--;
+
+    if ((mBatchDepth == 0) && mBatchChanged) {
+        mBatchChanged = false;
+        mw->updateDocOrderList_reset();
+        mw->updateBreadcrumbs();
+    }
+}
+
+bool MainWindow::Documents::notify()
+{
+    // Returns whether the UI should be notified of a change now. If batching,
+    // the change is recorded and notified at the end of the batch.
+    if (mBatchDepth > 0) {
+        mBatchChanged = true;
+        return false;
+    }
+    return true;
 }
 
 void MainWindow::on_action_Exit_Order_Mode_triggered()
@@ -1069,7 +2599,9 @@ void MainWindow::on_action_Move_Doc_Up_triggered()
     if (to >= documents.count()) { to = 0; }
 
     documents.move(from, to);
-    setSessionModified(true);
+    undoStack.push("Move Document",
+                   [=]() { documents.move(to, from); },
+                   [=]() { documents.move(from, to); });
 
     // Keep moved item selected
     ui->listWidget_docs->setCurrentItem(item);
@@ -1087,7 +2619,9 @@ void MainWindow::on_action_Move_Doc_Down_triggered()
     if (to >= documents.count()) { to = 0; }
 
     documents.move(from, to);
-    setSessionModified(true);
+    undoStack.push("Move Document",
+                   [=]() { documents.move(to, from); },
+                   [=]() { documents.move(from, to); });
 
     // Keep moved item selected
     ui->listWidget_docs->setCurrentItem(item);
@@ -1105,7 +2639,7 @@ void MainWindow::on_action_Order_Remove_Document_triggered()
         return;
     }
 
-    removeDocAndShowOther(doc);
+    removeDocument(doc);
 }
 
 void MainWindow::on_action_Exit_Crop_Mode_triggered()
@@ -1174,3 +2708,40 @@ void MainWindow::on_pushButton_about_clicked()
     ui->stackedWidget->setCurrentWidget(ui->page_about);
 }
 
+void MainWindow::on_action_Thumbnails_triggered()
+{
+    if (ui->action_Thumbnails->isChecked()) {
+        showThumbnailsView();
+    } else {
+        showMainPagesView();
+    }
+}
+
+void MainWindow::on_action_Auto_Crop_triggered()
+{
+    if (!currentDoc) { return; }
+    autoCrop(currentDoc->pages);
+}
+
+void MainWindow::on_action_Auto_Crop_All_triggered()
+{
+    if (!msgBoxYesNo("Auto Crop All", "Are you sure you want to automatically crop all pages of all documents?")) {
+        return;
+    }
+
+    QList<PagePtr> pages;
+    foreach (DocumentPtr doc, documents.all()) {
+        pages.append(doc->pages);
+    }
+    autoCrop(pages);
+}
+
+void MainWindow::on_action_Undo_triggered()
+{
+    undoStack.undo();
+}
+
+void MainWindow::on_action_Redo_triggered()
+{
+    undoStack.redo();
+}
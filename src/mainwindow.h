@@ -21,10 +21,22 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include "commandserver.h"
+#include "compositescene.h"
 #include "drawcurve.h"
 #include "gidfile.h"
-#include "pagescene.h"
+#include "memorygovernor.h"
+#include "pdfregistry.h"
+#include "renderscheduler.h"
+#include "scenepool.h"
+#include "sessionreader.h"
+#include "sessionwriter.h"
 #include "settings.h"
+#include "startupsnapshot.h"
+#include "startuptimeline.h"
+#include "synclink.h"
+#include "thumbnailcache.h"
+#include "undostack.h"
 #include "version.h"
 
 #include <QGraphicsPathItem>
@@ -33,11 +45,19 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QMainWindow>
+#include <QPointer>
+#include <QPropertyAnimation>
 #include <QPainterPath>
+#include <QScopedPointer>
+#include <QSet>
 #include <QSharedPointer>
 
+#include <QFutureWatcher>
+
 #include <QDebug>
 
+#include <functional>
+
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
@@ -50,7 +70,8 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
-    void makeAllToolbarsCentered();
+    // Toolbars are centered when first shown
+    void centerToolbar(QToolBar* toolbar);
     void showOnlyToolbar(QToolBar* toolbar);
     QList<QToolBar*> allToolbars();
 
@@ -63,6 +84,9 @@ public:
 
     bool msgBoxYesNo(QString title, QString text);
 
+    void startCommandServer(QString name, bool midi);
+    void startSync(SyncLink::Role role, QString name);
+
 private:
     Ui::MainWindow *ui;
 
@@ -70,13 +94,21 @@ private:
     void updateAboutPage();
     QFont getMonospaceFont();
 
+    // Pages of the stacked widget that aren't shown at startup (e.g. about,
+    // thumbnails) are set up when first shown, so they don't delay the first
+    // frame
+    QSet<QWidget*> mInitialisedPages;
+    void initPage(QWidget* page);
+
     void showMainPagesView();
     void showDocOrderView();
+    void showThumbnailsView();
 
     void print(QString msg);
 
     Settings settings {"Noedigcode", "noedigcode.co.za", APP_NAME, APP_VERSION};
     void setupSettings();
+    void applyRenderSettings(bool reload);
 
     // -------------------------------------------------------------------------
 
@@ -84,7 +116,15 @@ private:
     {
         QString name;
         QString filepath;
-        QList<PageScenePtr> pages;
+        // Path the PDF was actually loaded from (may be relative to session)
+        QString resolvedFilepath;
+        // Pages of the PDF used by this document, e.g. "1-3, 7". Empty for all.
+        QString pageRange;
+        // PDF page numbers of the pages in this document, from pageRange
+        QList<int> pdfPages;
+        // Open PDF, shared with other documents referring to the same file
+        PdfSourcePtr source;
+        QList<PagePtr> pages;
     };
     typedef QSharedPointer<Document> DocumentPtr;
 
@@ -103,9 +143,17 @@ private:
         int indexOf(DocumentPtr doc);
         void remove(DocumentPtr doc);
         void move(int from, int to);
+
+        // Batch changes: UI notifications are suppressed until the outermost
+        // endBatch(), which then sends a single update.
+        void beginBatch();
+        void endBatch();
     private:
         MainWindow* mw;
         QList<DocumentPtr> documents;
+        int mBatchDepth = 0;
+        bool mBatchChanged = false;
+        bool notify();
     };
     friend class Documents;
 
@@ -114,12 +162,18 @@ private:
     void setupGraphicsView();
     bool mIsCropping = false;
     void enableCropping(bool enable);
+    void autoCrop(QList<PagePtr> pages);
     bool mGraphicsViewLeftMouseDown = false;
     int mSelrectEdge = 0;
     QPointF mSelStart;
 
+    // Crop rect at the start of a crop drag, for undo
+    QRectF mCropStartRect;
+
     bool mIsDrawing = false;
     DrawCurvePtr mDrawCurve;
+    // Curves erased during the current erase drag, for undo
+    QList<DrawCurvePtr> mErasedCurves;
     enum class DrawMode { Pen, Erase} mDrawMode;
     void setDrawPen();
     void setDrawErase();
@@ -133,18 +187,119 @@ private:
     void viewPage(DocumentPtr doc, int pageIndex);
     void scaleScene();
 
+    // Two-page and continuous modes show several pages in a composite scene.
+    // Cropping and drawing always use the single page view.
+    enum class ViewMode { SinglePage, TwoPages, Continuous, HalfPage } mViewMode = ViewMode::SinglePage;
+    void setViewMode(ViewMode mode);
+    bool usesCompositeView();
+    CompositeScene mCompositeScene;
+    // Document shown in the continuous composite scene
+    DocumentPtr mCompositeDoc;
+    bool mScrollToCurrentPage = false;
+    void showCompositePages();
+    void scaleCompositeScene();
+    void onCompositeScrolled();
+    QPointer<QPropertyAnimation> mScrollAnimation;
+    // Scroll the continuous view by the given viewport fraction. Returns false
+    // if already at the end in that direction.
+    bool scrollComposite(qreal fraction);
+
+    // Half-page turn mode: the first tap shows the top half of the next page
+    // above the bottom half of the current page, the second tap turns the
+    // page. The composite image is prepared in the background when a page is
+    // shown, so the half turn only has to show a ready pixmap.
+    bool mHalfTurned = false;
+    QGraphicsScene mHalfTurnScene;
+    QGraphicsPixmapItem* mHalfTurnItem = nullptr;
+    // Page the pending composite was prepared for
+    PagePtr mHalfTurnPage;
+    QFutureWatcher<QImage> mHalfTurnWatcher;
+    QPixmap mHalfTurnPixmap;
+    void setupHalfTurn();
+    void prepareHalfTurn();
+    bool showHalfTurn();
+    QPair<DocumentPtr, int> pageAfter(DocumentPtr doc, int pageIndex);
+
+    // Number of pages before and after the current page kept decoded. Adapted
+    // to the memory budget, see applyMemoryBudget().
+    const int defaultResidentPageRadius = 3;
+    const int maxResidentPageRadius = 8;
+    int mResidentPageRadius = defaultResidentPageRadius;
+    void updateResidentPages();
+    // Memory needed for one decoded page
+    qint64 decodedPageBytes();
+
+    // Rendered pages are kept within a budget that follows the memory
+    // available. Pages furthest from the current page are dropped first.
+    MemoryGovernor memoryGovernor;
+    // Budget for compressed renders, the rest is for decoded pages
+    qint64 mPageCacheBudget = 0;
+    // Pages further than this from the current page are not rendered in the
+    // background, as they would be dropped again. -1 for no limit.
+    int mRenderDistanceLimit = -1;
+    // Compressed bytes of the rendered pages, counted exactly by
+    // enforcePageCacheBudget() and increased by each render in between. It
+    // is never less than the actual size, so the pages only need to be walked
+    // when it goes over the budget.
+    qint64 mRenderedBytes = 0;
+    qint64 mDecodedBytes = 0;
+    void setupMemoryGovernor();
+    void applyMemoryBudget(qint64 budget, qint64 previous);
+    void enforcePageCacheBudget();
+
+    // Single pages are shown in scenes from a small pool: the current page,
+    // the next page (bound ahead of the turn) and a few recent ones.
+    const int scenePoolSize = 4;
+    ScenePool scenePool {scenePoolSize};
+
+    // Pages are rendered in the background, visible pages first, then the
+    // next page, then pages near the current page, then all others.
+    RenderScheduler renderScheduler;
+    void setupRenderScheduler();
+    void scheduleRenders();
+    void onPageRendered(PdfSource* source, int pdfPage, bool preview,
+                        int priority, qint64 renderMs);
+
     void removeDocAndShowOther(DocumentPtr doc);
+    void removeDocument(DocumentPtr doc);
+    void addDocuments(QStringList filepaths, QString pageRange = QString());
 
     // -------------------------------------------------------------------------
 
-    QJsonObject rectToJson(QRectF rect);
-    QRectF jsonToRect(QJsonObject obj);
-
     const QString mSessionExt = ".sheets";
     const QString mSessionFileFilter = "Sheet Sessions (*.sheets)";
 
+    // At startup the last viewed page is shown from the startup snapshot and
+    // the session is read after the first frame
+    StartupSnapshot mStartupSnapshot;
+    PagePtr mSnapshotPage;
+    QString mDeferredSession;
+    bool mFirstFrameShown = false;
+    bool showStartupSnapshot();
+    void saveStartupSnapshot();
+    // Shows the snapshot renders on the session pages before the PDFs are open
+    void attachStartupSnapshotRenders();
+    bool startupSnapshotRendersUsable();
+    // Puts the snapshot renders of the document's pages in the render cache
+    void useStartupSnapshotRenders(DocumentPtr doc);
+    void onFirstFrame();
+    void finishStartupTimeline(QString event);
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
     void clearSession();
+    DocumentPtr addSessionDocument(const SessionReader::Document& entry);
+    PdfRegistry pdfRegistry;
+    void resolveFilepath(DocumentPtr doc);
     void loadPdf(DocumentPtr doc);
+    // Opens the PDFs of the documents in parallel in the background (page
+    // counts and sizes only, nothing is rendered) and then loads the documents.
+    // Page sizes are also cached in the session file so a session has its
+    // geometry before its PDFs are opened. If given, loaded is called once the
+    // documents are loaded instead of showing the current page again.
+    void loadPdfs(QList<DocumentPtr> docs, std::function<void()> loaded = nullptr);
+    // Incremented when the session is cleared, so loads of a previous session
+    // are discarded
+    int mLoadGeneration = 0;
     bool writeSession(QString filepath);
     bool canSessionBeClosed();
 
@@ -153,19 +308,58 @@ private:
     bool mSessionModified = false;
     void setSessionModified(bool modified);
 
+    // Drawing, crop and document order edits can be undone. Other changes
+    // (setSessionModified(true)) make the saved state unreachable by undo.
+    UndoStack undoStack;
+    const qint64 undoMemoryLimit = 64 * 1024 * 1024;
+    void setupUndo();
+    // Push an edit of a page. Undo/redo shows the page.
+    void pushPageEdit(QString text, DocumentPtr doc, int pageIndex,
+                      UndoStack::Action undo, UndoStack::Action redo,
+                      qint64 bytes);
+    qint64 documentBytes(DocumentPtr doc);
+
     // -------------------------------------------------------------------------
 
     void updateDocOrderList_added(DocumentPtr doc, int index);
     void updateDocOrderList_cleared();
     void updateDocOrderList_removed(int index);
     void updateDocOrderList_moved(int from, int to);
-    void updateDocOrderListIndexes();
+    void updateDocOrderList_reset();
+    void updateDocOrderListIndexes(int from = 0);
 
     // -------------------------------------------------------------------------
 
     void setupBreadcrumbs();
     void updateBreadcrumbs();
 
+    // -------------------------------------------------------------------------
+
+    CommandServer commandServer;
+    // Returns an error message if the document or page doesn't exist
+    QString onExternalCommand(CommandServer::Command command);
+
+    // -------------------------------------------------------------------------
+
+    SyncLink syncLink;
+    // Session of the sync leader. Positions are only followed if it is the
+    // same as this session.
+    QString mSyncSession;
+    bool isSyncedSession();
+    void broadcastPosition();
+    void onSyncSession(QString filepath);
+    void onSyncPosition(SyncLink::Position position);
+    // Page the leader will most likely show next. It is rendered with next
+    // turn priority and kept decoded, see scheduleRenders().
+    QPair<DocumentPtr, int> mSyncNextPage;
+
+    // -------------------------------------------------------------------------
+
+    // Created when the thumbnails page is first shown
+    QScopedPointer<ThumbnailCache> thumbnailCache;
+    QList<QPair<DocumentPtr, int>> mThumbnailPages;
+    void setupThumbnails();
+
 private slots:
     void onGraphicsViewLeftClick(QPointF pos);
     void onGraphicsViewLeftMouseDragStart(QPointF pos);
@@ -177,6 +371,7 @@ private slots:
     void on_action_Previous_Page_triggered();
     void on_action_Crop_triggered();
     void on_action_Add_Document_triggered();
+    void on_action_Add_Document_Pages_triggered();
     void on_action_Save_Session_triggered();
     void on_action_Open_Session_triggered();
     void on_action_Fullscreen_triggered();
@@ -194,6 +389,8 @@ private slots:
     void on_action_Move_Doc_Down_triggered();
     void on_action_Order_Remove_Document_triggered();
     void on_action_Exit_Crop_Mode_triggered();
+    void on_action_Auto_Crop_triggered();
+    void on_action_Auto_Crop_All_triggered();
     void on_action_Settings_triggered();
     void on_toolButton_iconhsize_up_clicked();
     void on_toolButton_ioconhsize_down_clicked();
@@ -202,6 +399,9 @@ private slots:
     void on_action_Zoom_triggered();
     void on_pushButton_console_clicked();
     void on_pushButton_about_clicked();
+    void on_action_Thumbnails_triggered();
+    void on_action_Undo_triggered();
+    void on_action_Redo_triggered();
 
 protected:
     void closeEvent(QCloseEvent* event) override;
@@ -0,0 +1,114 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "mappedfile.h"
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QWeakPointer>
+
+static QMutex openMutex;
+static QHash<QString, QWeakPointer<MappedFile>> openFiles;
+
+MappedFile::MappedFile(QString filepath)
+    : mFile(filepath)
+{
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        mErrorString = mFile.errorString();
+        return;
+    }
+
+    // Empty files can't be mapped, but are valid (empty) files
+    if (mFile.size() > 0) {
+        mMapped = mFile.map(0, mFile.size());
+        if (!mMapped) {
+            mErrorString = "Failed to map file: " + mFile.errorString();
+            mFile.close();
+            return;
+        }
+        mData = QByteArray::fromRawData((const char*)mMapped, mFile.size());
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    mData.clear();
+    if (mMapped) {
+        mFile.unmap(mMapped);
+    }
+}
+
+MappedFilePtr MappedFile::open(QString filepath)
+{
+    QFileInfo fi(filepath);
+    QString key = QString("%1|%2")
+            .arg(fi.canonicalFilePath().isEmpty() ? filepath : fi.canonicalFilePath())
+            .arg(fi.lastModified().toMSecsSinceEpoch());
+
+    QMutexLocker locker(&openMutex);
+
+    MappedFilePtr file = openFiles.value(key).toStrongRef();
+    if (file) { return file; }
+
+    file.reset(new MappedFile(filepath));
+    if (file->isOpen()) {
+        openFiles.insert(key, file);
+    }
+
+    // Remove released mappings
+    QMutableHashIterator<QString, QWeakPointer<MappedFile>> i(openFiles);
+    while (i.hasNext()) {
+        if (i.next().value().isNull()) { i.remove(); }
+    }
+
+    return file;
+}
+
+bool MappedFile::isOpen()
+{
+    return mFile.isOpen();
+}
+
+QString MappedFile::errorString()
+{
+    return mErrorString;
+}
+
+qint64 MappedFile::size()
+{
+    return mData.size();
+}
+
+QByteArray MappedFile::data()
+{
+    return mData;
+}
+
+QIODevice* MappedFile::createDevice()
+{
+    QBuffer* buffer = new QBuffer();
+    // Shares the raw mapped data, no deep copy is made for read-only access
+    buffer->setData(mData);
+    buffer->open(QIODevice::ReadOnly);
+    return buffer;
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* MappedFile
+ *
+ * Read-only memory mapped file. The file contents are accessed directly from
+ * the mapping without copying it to the heap, so the kernel can page it in and
+ * out as needed and resident memory tracks what is actually used.
+ *
+ * Mappings are shared: open() returns the existing mapping if the same file
+ * (canonical path and modification time) is already mapped, also from other
+ * threads. A mapping is released when the last reference to it is dropped.
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QSharedPointer>
+
+class MappedFile;
+typedef QSharedPointer<MappedFile> MappedFilePtr;
+
+class MappedFile
+{
+public:
+    ~MappedFile();
+
+    static MappedFilePtr open(QString filepath);
+
+    bool isOpen();
+    QString errorString();
+    qint64 size();
+
+    // File contents. Refers to the mapping (no copy) and is only valid while
+    // this object exists.
+    QByteArray data();
+
+    // New read-only device over the mapping. Caller takes ownership. Each
+    // reader (e.g. each QPdfDocument or thread) should have its own device.
+    QIODevice* createDevice();
+
+private:
+    MappedFile(QString filepath);
+
+    QFile mFile;
+    uchar* mMapped = nullptr;
+    QByteArray mData;
+    QString mErrorString;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,244 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "memorygovernor.h"
+
+#include <QDir>
+#include <QFile>
+
+static const qint64 MB = 1024 * 1024;
+// Page cache budget before the first sample and its bounds
+static const qint64 defaultBudget = 512 * MB;
+static const qint64 minBudget = 32 * MB;
+static const qint64 maxBudget = 2048 * MB;
+// Memory always left for other software
+static const qint64 reserveBytes = 256 * MB;
+
+// Memory control group directories of this process, innermost first
+struct MemoryCgroup {
+    QStringList dirs;
+    bool v2 = false;
+};
+
+static MemoryCgroup findMemoryCgroup()
+{
+    MemoryCgroup cgroup;
+
+    // The process's cgroup paths, e.g. "0::/user.slice/app.scope" (v2) and
+    // "4:memory:/user.slice" (v1). Both may be listed (hybrid hierarchy), in
+    // which case memory is controlled by v1.
+    QString v1Path;
+    QString v2Path;
+    QFile file("/proc/self/cgroup");
+    if (!file.open(QIODevice::ReadOnly)) { return cgroup; }
+    foreach (QByteArray line, file.readAll().split('\n')) {
+        QList<QByteArray> parts = line.split(':');
+        if (parts.count() < 3) { continue; }
+        QString path = QString::fromUtf8(line.mid(parts[0].size() + parts[1].size() + 2));
+        if ((parts[0] == "0") && parts[1].isEmpty()) {
+            v2Path = path;
+        } else if (parts[1].split(',').contains("memory")) {
+            v1Path = path;
+        }
+    }
+
+    // Where the hierarchies are mounted, e.g.
+    // "36 32 0:32 / /sys/fs/cgroup/memory rw - cgroup cgroup rw,memory"
+    QString v1Mount;
+    QString v1Root;
+    QString v2Mount;
+    QString v2Root;
+    QFile mounts("/proc/self/mountinfo");
+    if (!mounts.open(QIODevice::ReadOnly)) { return cgroup; }
+    foreach (QByteArray line, mounts.readAll().split('\n')) {
+        int separator = line.indexOf(" - ");
+        if (separator < 0) { continue; }
+        QList<QByteArray> fields = line.left(separator).split(' ');
+        QList<QByteArray> fsFields = line.mid(separator + 3).split(' ');
+        if ((fields.count() < 5) || (fsFields.count() < 3)) { continue; }
+        if (fsFields[0] == "cgroup2") {
+            v2Root = QString::fromUtf8(fields[3]);
+            v2Mount = QString::fromUtf8(fields[4]);
+        } else if ((fsFields[0] == "cgroup") && fsFields[2].split(',').contains("memory")) {
+            v1Root = QString::fromUtf8(fields[3]);
+            v1Mount = QString::fromUtf8(fields[4]);
+        }
+    }
+
+    QString path;
+    QString root;
+    QString mount;
+    if (!v1Path.isEmpty() && !v1Mount.isEmpty()) {
+        path = v1Path;
+        root = v1Root;
+        mount = v1Mount;
+    } else if (!v2Path.isEmpty() && !v2Mount.isEmpty()) {
+        path = v2Path;
+        root = v2Root;
+        mount = v2Mount;
+        cgroup.v2 = true;
+    } else {
+        return cgroup;
+    }
+
+    // In a container the mount may be of the process's own cgroup or one of
+    // its ancestors, rather than the root
+    if ((root != "/") && path.startsWith(root)) {
+        path = path.mid(root.size());
+    }
+
+    // A limit on an ancestor applies as well
+    QString dir = QDir::cleanPath(mount + "/" + path);
+    while (dir.startsWith(mount)) {
+        cgroup.dirs.append(dir);
+        if (dir == mount) { break; }
+        dir = dir.left(dir.lastIndexOf('/'));
+    }
+    return cgroup;
+}
+
+MemoryGovernor::MemoryGovernor(QObject* parent)
+    : QObject{parent}
+{
+    mBudget = defaultBudget;
+    mTimer.setInterval(interval);
+    connect(&mTimer, &QTimer::timeout, this, &MemoryGovernor::onTimer);
+}
+
+MemoryGovernor::Sample MemoryGovernor::sample()
+{
+    Sample s;
+    qint64 rssKb = readProcValueKb("/proc/self/status", "VmRSS");
+    if (rssKb >= 0) { s.rssBytes = rssKb * 1024; }
+    qint64 availableKb = readProcValueKb("/proc/meminfo", "MemAvailable");
+    if (availableKb >= 0) { s.availableBytes = availableKb * 1024; }
+
+    // The cgroup of the process is found once. The least room below the
+    // limit of it and its ancestors counts. Without a limit, v2 reads "max"
+    // and v1 a huge number.
+    static const MemoryCgroup cgroup = findMemoryCgroup();
+    QString limitFile = cgroup.v2 ? "memory.max" : "memory.limit_in_bytes";
+    QString usageFile = cgroup.v2 ? "memory.current" : "memory.usage_in_bytes";
+    QString inactiveName = cgroup.v2 ? "inactive_file" : "total_inactive_file";
+    qint64 cgroupRoom = -1;
+    foreach (QString dir, cgroup.dirs) {
+        qint64 limit = readCgroupValue(dir + "/" + limitFile);
+        qint64 usage = readCgroupValue(dir + "/" + usageFile);
+        if ((limit <= 0) || (limit >= (qint64(1) << 60)) || (usage < 0)) { continue; }
+
+        // Usage includes file cache, which is reclaimed before the limit is
+        // hit. The process's own resident memory is in use regardless.
+        qint64 inactive = readStatValue(dir + "/memory.stat", inactiveName);
+        qint64 used = qMax(usage - qMax(qint64(0), inactive), s.rssBytes);
+        qint64 room = qMax(qint64(0), limit - used);
+        if ((cgroupRoom < 0) || (room < cgroupRoom)) {
+            cgroupRoom = room;
+            s.limitBytes = limit;
+        }
+    }
+    if ((cgroupRoom >= 0)
+            && ((s.availableBytes < 0) || (cgroupRoom < s.availableBytes)))
+    {
+        s.availableBytes = cgroupRoom;
+    }
+    return s;
+}
+
+void MemoryGovernor::start()
+{
+    onTimer();
+    mTimer.start();
+}
+
+void MemoryGovernor::setCacheBytes(qint64 bytes)
+{
+    mCacheBytes = bytes;
+}
+
+qint64 MemoryGovernor::budget()
+{
+    return mBudget;
+}
+
+MemoryGovernor::Sample MemoryGovernor::lastSample()
+{
+    return mLastSample;
+}
+
+void MemoryGovernor::onTimer()
+{
+    mLastSample = sample();
+    if (!mLastSample.isValid()) { return; }
+
+    qint64 headroom = mLastSample.availableBytes - reserveBytes;
+    qint64 target = mCacheBytes + ((headroom > 0) ? headroom / 2 : headroom);
+    target = qBound(minBudget, target, maxBudget);
+
+    // Always follow a shortfall, otherwise only notable changes
+    bool shortfall = (headroom < 0) && (target < mBudget);
+    if (!shortfall && (qAbs(target - mBudget) < mBudget * hysteresis)) { return; }
+    if (target == mBudget) { return; }
+
+    qint64 previous = mBudget;
+    mBudget = target;
+    emit budgetChanged(mBudget, previous);
+}
+
+qint64 MemoryGovernor::readProcValueKb(QString filepath, QString name)
+{
+    // Lines such as "MemAvailable:   123456 kB"
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly)) { return -1; }
+    QByteArray prefix = name.toLatin1() + ":";
+    // Files in /proc report a size of zero, so read all instead of by line
+    foreach (QByteArray line, file.readAll().split('\n')) {
+        if (!line.startsWith(prefix)) { continue; }
+        QList<QByteArray> parts = line.mid(prefix.size()).simplified().split(' ');
+        bool ok = false;
+        qint64 value = parts.value(0).toLongLong(&ok);
+        return ok ? value : -1;
+    }
+    return -1;
+}
+
+qint64 MemoryGovernor::readStatValue(QString filepath, QString name)
+{
+    // Lines such as "inactive_file 123456" (bytes)
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly)) { return -1; }
+    QByteArray prefix = name.toLatin1() + " ";
+    foreach (QByteArray line, file.readAll().split('\n')) {
+        if (!line.startsWith(prefix)) { continue; }
+        bool ok = false;
+        qint64 value = line.mid(prefix.size()).trimmed().toLongLong(&ok);
+        return ok ? value : -1;
+    }
+    return -1;
+}
+
+qint64 MemoryGovernor::readCgroupValue(QString filepath)
+{
+    // A single number, or "max" for no limit
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly)) { return -1; }
+    bool ok = false;
+    qint64 value = file.readAll().trimmed().toLongLong(&ok);
+    return ok ? value : -1;
+}
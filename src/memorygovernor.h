@@ -0,0 +1,90 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* MemoryGovernor
+ *
+ * Adapts the memory used for rendered pages to the memory available on the
+ * machine, which varies when other software (audio, lighting) runs alongside.
+ *
+ * The governor samples memory every few seconds: the memory available to the
+ * system (/proc/meminfo) and, when the process's control group (found from
+ * /proc/self/cgroup) or one of its ancestors has a memory limit, the room
+ * left below that limit (cgroup v2 memory.max or v1 memory.limit_in_bytes).
+ * Reclaimable file cache is not counted as used in the cgroup, but the
+ * process resident set size (/proc/self/status) always is. A reserve is
+ * always left for other software. Half of any further free memory may be
+ * taken by the page cache, while a shortfall is taken from it in full.
+ *
+ * The GUI reports the current page cache size with setCacheBytes() and
+ * applies the budget given by budgetChanged(). The budget only changes when
+ * it differs notably from the previous one, so it doesn't follow every small
+ * fluctuation.
+ *
+ * Where these files don't exist (not Linux) the budget stays at the default.
+ */
+
+#ifndef MEMORYGOVERNOR_H
+#define MEMORYGOVERNOR_H
+
+#include <QObject>
+#include <QTimer>
+
+class MemoryGovernor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MemoryGovernor(QObject* parent = nullptr);
+
+    struct Sample {
+        qint64 rssBytes = -1;
+        // Available to the system, or below the cgroup limit if that is less
+        qint64 availableBytes = -1;
+        // Cgroup memory limit, -1 if none
+        qint64 limitBytes = -1;
+        bool isValid() { return availableBytes >= 0; }
+    };
+    static Sample sample();
+
+    void start();
+    void setCacheBytes(qint64 bytes);
+    qint64 budget();
+    Sample lastSample();
+
+signals:
+    void budgetChanged(qint64 budget, qint64 previous);
+
+private:
+    // Sampling interval (ms)
+    const int interval = 2000;
+    // Budget changes smaller than this fraction are ignored
+    const double hysteresis = 0.1;
+
+    QTimer mTimer;
+    qint64 mCacheBytes = 0;
+    qint64 mBudget = 0;
+    Sample mLastSample;
+    void onTimer();
+
+    static qint64 readProcValueKb(QString filepath, QString name);
+    static qint64 readCgroupValue(QString filepath);
+    static qint64 readStatValue(QString filepath, QString name);
+};
+
+#endif // MEMORYGOVERNOR_H
@@ -0,0 +1,212 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "page.h"
+#include "annotationlayer.h"
+#include "pagescene.h"
+
+Page::~Page()
+{
+    setResident(false);
+}
+
+void Page::setImageSize(QSize size)
+{
+    mImageSize = size;
+    mPageRect = QRectF();
+    notify(Change::Rects);
+}
+
+void Page::setPageImage(PageImagePtr image)
+{
+    bool resident = mResident;
+    setResident(false);
+    mImage = image;
+    if (mImage) {
+        mImageSize = mImage->size();
+        mPreview = QImage();
+    }
+    setResident(resident);
+    mPageRect = QRectF();
+    notify(Change::Image);
+    notify(Change::Rects);
+}
+
+PageImagePtr Page::pageImage()
+{
+    return mImage;
+}
+
+void Page::setPreview(QImage preview)
+{
+    if (mImage || preview.isNull()) { return; }
+
+    mPreview = preview;
+    notify(Change::Image);
+}
+
+QImage Page::preview()
+{
+    return mPreview;
+}
+
+bool Page::hasPreview()
+{
+    return !mPreview.isNull();
+}
+
+QRectF Page::imageRect()
+{
+    if (mImageSize.isEmpty()) { return QRectF(); }
+    return QRectF(QPointF(0, 0), mImageSize);
+}
+
+void Page::setResident(bool resident)
+{
+    if (mImage && (resident != mResident)) {
+        if (resident) {
+            mImage->acquire();
+        } else {
+            mImage->release();
+        }
+    }
+    mResident = resident;
+}
+
+bool Page::isResident()
+{
+    return mResident;
+}
+
+void Page::setPageRectToCropRect()
+{
+    mPageRect = mCropRect;
+    notify(Change::Rects);
+}
+
+void Page::setPageRect(QRectF rect)
+{
+    mPageRect = rect;
+    notify(Change::Rects);
+}
+
+QRectF Page::getPageRect()
+{
+    if (!mPageRect.isNull()) { return mPageRect; }
+    return getCropRect();
+}
+
+void Page::setCropRect(QRectF rect)
+{
+    mCropRect = rect;
+    notify(Change::Rects);
+}
+
+QRectF Page::getCropRect()
+{
+    if (!mCropRect.isNull()) { return mCropRect; }
+    return imageRect();
+}
+
+void Page::showCropRect(bool show)
+{
+    mCropRectShown = show;
+    notify(Change::Rects);
+}
+
+bool Page::isCropRectShown()
+{
+    return mCropRectShown;
+}
+
+void Page::setZoomRect(QRectF rect)
+{
+    mZoomRect = rect;
+    notify(Change::Rects);
+}
+
+QRectF Page::getZoomRect()
+{
+    return mZoomRect;
+}
+
+void Page::showZoomRect(bool show)
+{
+    mZoomRectShown = show;
+    notify(Change::Rects);
+}
+
+bool Page::isZoomRectShown()
+{
+    return mZoomRectShown;
+}
+
+void Page::addDrawCurve(DrawCurvePtr drawCurve)
+{
+    mDrawCurves.append(drawCurve);
+    notify(Change::Curves);
+}
+
+void Page::beginDrawCurve(DrawCurvePtr drawCurve)
+{
+    mLiveCurve = drawCurve;
+    mDrawCurves.append(drawCurve);
+    notify(Change::Curves);
+}
+
+void Page::endDrawCurve()
+{
+    if (!mLiveCurve) { return; }
+
+    mLiveCurve.reset();
+    notify(Change::Curves);
+}
+
+QList<DrawCurvePtr> Page::drawCurves()
+{
+    return mDrawCurves;
+}
+
+DrawCurvePtr Page::liveCurve()
+{
+    return mLiveCurve;
+}
+
+void Page::removeDrawCurve(DrawCurvePtr drawCurve)
+{
+    if (drawCurve == mLiveCurve) {
+        mLiveCurve.reset();
+    }
+    mDrawCurves.removeAll(drawCurve);
+    notify(Change::Curves);
+}
+
+void Page::notify(Change change)
+{
+    if (mScene) { mScene->pageChanged(change); }
+}
+
+QSharedPointer<AnnotationCache> Page::annotationCache()
+{
+    if (!mAnnotationCache) {
+        mAnnotationCache.reset(new AnnotationCache());
+    }
+    return mAnnotationCache;
+}
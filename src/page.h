@@ -0,0 +1,121 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* Page
+ *
+ * Data of a page in a document: the rendered image (or its size and a preview
+ * until it is rendered), the page and crop rectangles, the zoom rectangle and
+ * the drawn curves. A page holds no graphics items, so a session with many
+ * pages stays cheap.
+ *
+ * Pages are shown by binding them to a PageScene (see ScenePool). Changes made
+ * to a page are passed on to the scene it is bound to, if any.
+ */
+
+#ifndef PAGE_H
+#define PAGE_H
+
+#include "drawcurve.h"
+#include "pageimage.h"
+
+#include <QImage>
+#include <QRectF>
+#include <QSharedPointer>
+
+class PageScene;
+struct AnnotationCache;
+
+class Page
+{
+public:
+    ~Page();
+
+    enum class Change { Image, Rects, Curves };
+
+    // Size of the page image, so the page has its geometry before the image
+    // has been rendered
+    void setImageSize(QSize size);
+    void setPageImage(PageImagePtr image);
+    PageImagePtr pageImage();
+    // Low resolution image shown stretched to the page geometry until the
+    // page image is set. An image rather than a pixmap, as pages may be
+    // created in other threads (see SessionReader::readDocuments()).
+    void setPreview(QImage preview);
+    QImage preview();
+    bool hasPreview();
+    QRectF imageRect();
+
+    // Only resident pages have their image decoded to a pixmap
+    void setResident(bool resident);
+    bool isResident();
+
+    void setPageRectToCropRect();
+    void setPageRect(QRectF rect);
+    QRectF getPageRect();
+
+    // The crop rect is the image rect until it is set
+    void setCropRect(QRectF rect);
+    QRectF getCropRect();
+    void showCropRect(bool show);
+    bool isCropRectShown();
+
+    void setZoomRect(QRectF rect);
+    QRectF getZoomRect();
+    void showZoomRect(bool show);
+    bool isZoomRectShown();
+
+    // The curve being drawn (between beginDrawCurve() and endDrawCurve()) is
+    // shown as a separate item, the others from a cached overlay.
+    void addDrawCurve(DrawCurvePtr drawCurve);
+    void beginDrawCurve(DrawCurvePtr drawCurve);
+    void endDrawCurve();
+    QList<DrawCurvePtr> drawCurves();
+    DrawCurvePtr liveCurve();
+    void removeDrawCurve(DrawCurvePtr drawCurve);
+    // Rasterised curves, see AnnotationLayer. Only used in the GUI thread.
+    QSharedPointer<AnnotationCache> annotationCache();
+
+private:
+    friend class PageScene;
+    // Scene this page is bound to
+    PageScene* mScene = nullptr;
+    void notify(Change change);
+
+    PageImagePtr mImage;
+    QSize mImageSize;
+    QImage mPreview;
+    bool mResident = false;
+
+    // Null rects are derived: the page rect from the crop rect and the crop
+    // rect from the image rect.
+    QRectF mPageRect;
+    QRectF mCropRect;
+    bool mCropRectShown = false;
+    QRectF mZoomRect;
+    bool mZoomRectShown = false;
+
+    QList<DrawCurvePtr> mDrawCurves;
+    DrawCurvePtr mLiveCurve;
+    QSharedPointer<AnnotationCache> mAnnotationCache;
+};
+
+typedef QSharedPointer<Page> PagePtr;
+
+#endif // PAGE_H
@@ -0,0 +1,261 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "pageimage.h"
+
+#include <QPainter>
+
+#include <cstring>
+
+// Fast compression level. Decompression speed is what matters for page turns.
+static const int compressionLevel = 1;
+
+// Bytes of a scanline that hold pixels. Scanlines are padded to 32 bits and
+// the padding is not initialised, so it is left out of the stored data and
+// the hash.
+static int lineBytes(const QImage& image)
+{
+    return (image.width() * image.depth() + 7) / 8;
+}
+
+// Scanline with the unused bits of its last byte cleared (1-bit images)
+static void copyLine(const QImage& image, int y, uchar* dest)
+{
+    int bytes = lineBytes(image);
+    memcpy(dest, image.constScanLine(y), bytes);
+    int usedBits = (image.width() * image.depth()) % 8;
+    if (usedBits == 0) { return; }
+    if (image.format() == QImage::Format_MonoLSB) {
+        dest[bytes - 1] &= (uchar)((1 << usedBits) - 1);
+    } else {
+        dest[bytes - 1] &= (uchar)(0xFF << (8 - usedBits));
+    }
+}
+
+// Pixel data without scanline padding
+static QByteArray packedBits(const QImage& image)
+{
+    int bytes = lineBytes(image);
+    QByteArray data(bytes * image.height(), Qt::Uninitialized);
+    uchar* dest = (uchar*)data.data();
+    for (int y = 0; y < image.height(); y++) {
+        copyLine(image, y, dest + y * bytes);
+    }
+    return data;
+}
+
+PageImage::PageImage(QImage image)
+{
+    // Pages are rendered with a transparent background. Flatten onto white,
+    // as transparent pixels would otherwise become black when converted.
+    if (image.hasAlphaChannel()) {
+        QImage flat(image.size(), QImage::Format_RGB32);
+        flat.fill(Qt::white);
+        QPainter painter(&flat);
+        painter.drawImage(0, 0, image);
+        painter.end();
+        image = flat;
+    }
+
+    // Sheet music is mostly black and white. If the page has no color, store
+    // it as 8-bit grayscale, which loses nothing.
+    if ((image.format() != QImage::Format_Mono)
+            && (image.format() != QImage::Format_Grayscale8)
+            && image.allGray())
+    {
+        image = image.convertToFormat(QImage::Format_Grayscale8);
+    }
+
+    mSize = image.size();
+    mFormat = image.format();
+    mBytesPerLine = lineBytes(image);
+    mColorTable = image.colorTable();
+    mCompressed = qCompress(packedBits(image), compressionLevel);
+    mContentHash = hash(image);
+}
+
+QSize PageImage::size()
+{
+    return mSize;
+}
+
+QImage::Format PageImage::format()
+{
+    return mFormat;
+}
+
+qint64 PageImage::compressedBytes()
+{
+    return mCompressed.size();
+}
+
+quint64 PageImage::contentHash()
+{
+    return mContentHash;
+}
+
+bool PageImage::hasSameContent(PageImage* other)
+{
+    return (mContentHash == other->mContentHash)
+            && (mSize == other->mSize)
+            && (mFormat == other->mFormat)
+            && (mColorTable == other->mColorTable)
+            && (mCompressed == other->mCompressed);
+}
+
+quint64 PageImage::hash(const QImage& image)
+{
+    // 64-bit multiply and xor-shift over 8 bytes at a time (FNV style). Only
+    // used to find candidates, which are then compared in full.
+    const quint64 prime = 0x100000001b3ULL;
+    quint64 h = 0xcbf29ce484222325ULL;
+    h = (h ^ (quint64)image.width()) * prime;
+    h = (h ^ (quint64)image.height()) * prime;
+    h = (h ^ (quint64)image.format()) * prime;
+
+    // Scanline by scanline, leaving out the padding (see lineBytes())
+    int bytes = lineBytes(image);
+    int words = bytes / 8;
+    QByteArray line(bytes, Qt::Uninitialized);
+    const uchar* data = (const uchar*)line.constData();
+    for (int y = 0; y < image.height(); y++) {
+        copyLine(image, y, (uchar*)line.data());
+        for (int i = 0; i < words; i++) {
+            quint64 w;
+            memcpy(&w, data + i * 8, 8);
+            h = (h ^ w) * prime;
+            h ^= h >> 29;
+        }
+        for (int i = words * 8; i < bytes; i++) {
+            h = (h ^ data[i]) * prime;
+        }
+    }
+    return h;
+}
+
+QImage PageImage::image()
+{
+    QByteArray data = qUncompress(mCompressed);
+    if (data.isEmpty()) { return QImage(); }
+
+    QImage image(mSize, mFormat);
+    if (image.isNull()) { return QImage(); }
+    if (!mColorTable.isEmpty()) {
+        image.setColorTable(mColorTable);
+    }
+    // Stored scanlines are unpadded, except in files written before that
+    if (data.size() < (qint64)mBytesPerLine * mSize.height()) { return QImage(); }
+    if (image.bytesPerLine() == mBytesPerLine) {
+        memcpy(image.bits(), data.constData(), image.sizeInBytes());
+    } else {
+        int copyBytes = qMin(image.bytesPerLine(), mBytesPerLine);
+        for (int y = 0; y < mSize.height(); y++) {
+            memcpy(image.scanLine(y), data.constData() + y * mBytesPerLine, copyBytes);
+        }
+    }
+    return image;
+}
+
+QPixmap PageImage::acquire()
+{
+    if (mUsers == 0) {
+        mPixmap.reset(new QPixmap(QPixmap::fromImage(image())));
+    }
+    mUsers++;
+    return *mPixmap;
+}
+
+void PageImage::release()
+{
+    if (mUsers <= 0) { return; }
+    mUsers--;
+    if (mUsers == 0) {
+        mPixmap.reset();
+    }
+}
+
+bool PageImage::isResident()
+{
+    return mUsers > 0;
+}
+
+void PageImage::write(QDataStream& stream)
+{
+    stream << mSize << (qint32)mFormat << (qint32)mBytesPerLine
+           << mColorTable << mCompressed << mContentHash;
+}
+
+QSharedPointer<PageImage> PageImage::read(QDataStream& stream)
+{
+    QSharedPointer<PageImage> image(new PageImage());
+    qint32 format = 0;
+    qint32 bytesPerLine = 0;
+    stream >> image->mSize >> format >> bytesPerLine
+           >> image->mColorTable >> image->mCompressed >> image->mContentHash;
+    if (stream.status() != QDataStream::Ok) { return QSharedPointer<PageImage>(); }
+
+    image->mFormat = (QImage::Format)format;
+    image->mBytesPerLine = bytesPerLine;
+    return image;
+}
+
+
+QMultiHash<quint64, QWeakPointer<PageImage>> PageImageStore::mImages;
+QMutex PageImageStore::mMutex;
+
+// Number of stored images between removals of freed entries
+static const int pruneInterval = 256;
+
+PageImagePtr PageImageStore::intern(PageImagePtr image)
+{
+    if (!image) { return image; }
+
+    QMutexLocker locker(&mMutex);
+
+    quint64 key = image->contentHash();
+    auto it = mImages.find(key);
+    while ((it != mImages.end()) && (it.key() == key)) {
+        PageImagePtr stored = it.value().toStrongRef();
+        if (!stored) {
+            // Image was freed
+            it = mImages.erase(it);
+            continue;
+        }
+        if (stored == image) { return image; }
+        if (stored->hasSameContent(image.data())) {
+            return stored;
+        }
+        ++it;
+    }
+
+    // Drop freed images now and then so the table doesn't keep growing
+    if (mImages.count() % pruneInterval == pruneInterval - 1) {
+        it = mImages.begin();
+        while (it != mImages.end()) {
+            if (it.value().isNull()) {
+                it = mImages.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    mImages.insert(key, image);
+    return image;
+}
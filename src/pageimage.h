@@ -0,0 +1,110 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* PageImage
+ *
+ * Compact in-memory storage of a rendered page.
+ *
+ * Rendered pages are stored compressed. Pages that contain only gray pixels
+ * (most sheet music) are first converted losslessly to 8-bit grayscale, which
+ * is a quarter of the size of the rendered ARGB image, and then compressed.
+ *
+ * A pixmap is only decoded while the page is in use (e.g. near the current
+ * page). Users call acquire() to get the pixmap and release() when done. The
+ * pixmap is shared by all users and dropped when the last one releases it.
+ *
+ * Page images may be created in any thread, but acquire() and release() must
+ * only be used in the GUI thread.
+ *
+ * Identical renders (blank pages, repeated title or rest pages) are common in
+ * songbooks. PageImageStore keeps one page image per distinct content, so all
+ * pages with the same render share the compressed data and the pixmap.
+ */
+
+#ifndef PAGEIMAGE_H
+#define PAGEIMAGE_H
+
+#include <QDataStream>
+#include <QImage>
+#include <QMultiHash>
+#include <QMutex>
+#include <QPixmap>
+#include <QScopedPointer>
+#include <QSharedPointer>
+
+class PageImage
+{
+public:
+    PageImage(QImage image);
+
+    QSize size();
+    QImage::Format format();
+    qint64 compressedBytes();
+    // Hash of the image content, see hash()
+    quint64 contentHash();
+    bool hasSameContent(PageImage* other);
+
+    // Fast non-cryptographic hash of the image pixels and format
+    static quint64 hash(const QImage& image);
+
+    // Decompressed image
+    QImage image();
+
+    QPixmap acquire();
+    void release();
+    bool isResident();
+
+    // Compressed image data, e.g. for storing in a file
+    void write(QDataStream& stream);
+    static QSharedPointer<PageImage> read(QDataStream& stream);
+
+private:
+    PageImage() {}
+
+    QSize mSize;
+    QImage::Format mFormat = QImage::Format_Invalid;
+    int mBytesPerLine = 0;
+    QVector<QRgb> mColorTable;
+    QByteArray mCompressed;
+    quint64 mContentHash = 0;
+
+    // Only created in the GUI thread, in acquire()
+    QScopedPointer<QPixmap> mPixmap;
+    int mUsers = 0;
+};
+
+typedef QSharedPointer<PageImage> PageImagePtr;
+
+
+class PageImageStore
+{
+public:
+    // Returns the stored image with the same content if there is one,
+    // otherwise stores and returns the given image. May be called from any
+    // thread.
+    static PageImagePtr intern(PageImagePtr image);
+
+private:
+    // Only weak references are held, so images are freed when no longer used
+    static QMultiHash<quint64, QWeakPointer<PageImage>> mImages;
+    static QMutex mMutex;
+};
+
+#endif // PAGEIMAGE_H
@@ -23,140 +23,151 @@
 PageScene::PageScene()
 {
     setBackgroundBrush(QBrush(Qt::white));
-}
-
-void PageScene::setImage(QImage image)
-{
-    mPixmap = this->addPixmap(QPixmap::fromImage(image));
-    initPageRect();
-}
 
-void PageScene::setPageRectToCropRect()
-{
-    if (!mPagerect) { initPageRect(); }
-    if (!mCroprect) { return; }
-    mPagerect->setRect(mCroprect->rect());
-}
+    mPixmap = this->addPixmap(QPixmap());
 
-QRectF PageScene::getPageRect()
-{
-    if (!mPagerect) { initPageRect(); }
-    return mPagerect->rect();
-}
+    mPagerect = new QGraphicsRectItem();
+    QPen pagePen(Qt::black, 1);
+    pagePen.setCosmetic(true);
+    mPagerect->setPen(pagePen);
+    this->addItem(mPagerect);
+    mPagerect->setZValue(1);
 
-void PageScene::setCropRect(QRectF rect)
-{
-    if (!mCroprect) { initCropRect(); }
-    mCroprect->setRect(rect);
-}
+    mCroprect = new QGraphicsRectItem();
+    QPen cropPen(Qt::blue, 2);
+    cropPen.setCosmetic(true);
+    mCroprect->setPen(cropPen);
+    QColor fillColor("#676cf5");
+    fillColor.setAlphaF(0.5);
+    mCroprect->setBrush(fillColor); // Set semi-transparent blue fill
+    this->addItem(mCroprect);
+    mCroprect->setZValue(1);
+    mCroprect->hide();
 
-QRectF PageScene::getCropRect()
-{
-    if (!mCroprect) { initCropRect(); }
-    return mCroprect->rect();
-}
+    mZoomrect = new QGraphicsRectItem();
+    QPen zoomPen(Qt::blue, 2);
+    zoomPen.setCosmetic(true);
+    mZoomrect->setPen(zoomPen);
+    this->addItem(mZoomrect);
+    mZoomrect->setZValue(1);
+    mZoomrect->hide();
 
-void PageScene::showCropRect(bool show)
-{
-    if (show) {
-        if (!mCroprect) { initCropRect(); }
-        mCroprect->show();
-    } else {
-        if (mCroprect) { mCroprect->hide(); }
-    }
+    mAnnotations = new AnnotationLayer();
+    mAnnotations->setZValue(10);
+    this->addItem(mAnnotations);
 }
 
-void PageScene::setZoomRect(QRectF rect)
+PageScene::~PageScene()
 {
-    if (!mZoomrect) { initZoomRect(); }
-    mZoomrect->setRect(rect);
+    setPage(PagePtr());
 }
 
-QRectF PageScene::getZoomRect()
+void PageScene::setPage(PagePtr page)
 {
-    if (!mZoomrect) { initZoomRect(); }
-    return mZoomrect->rect();
-}
+    if (page == mPage) { return; }
 
-void PageScene::showZoomRect(bool show)
-{
-    if (show) {
-        if (!mZoomrect) { initZoomRect(); }
-        mZoomrect->show();
-    } else {
-        if (mZoomrect) { mZoomrect->hide(); }
+    if (mPage) {
+        mPage->mScene = nullptr;
+    }
+    mPage = page;
+    if (mPage) {
+        // A page is bound to one scene at a time
+        if (mPage->mScene) { mPage->mScene->setPage(PagePtr()); }
+        mPage->mScene = this;
     }
-}
 
-void PageScene::addDrawCurve(DrawCurvePtr drawCurve)
-{
-    mDrawCurves.append(drawCurve);
-    this->addItem(drawCurve->scenePathItem());
+    updateImage();
+    updateRects();
+    updateCurves();
 }
 
-QList<DrawCurvePtr> PageScene::drawCurves()
+PagePtr PageScene::page()
 {
-    return mDrawCurves;
+    return mPage;
 }
 
-void PageScene::removeDrawCurve(DrawCurvePtr drawCurve)
+void PageScene::pageChanged(Page::Change change)
 {
-    this->removeItem(drawCurve->scenePathItem());
-    mDrawCurves.removeAll(drawCurve);
+    switch (change) {
+    case Page::Change::Image:
+        updateImage();
+        break;
+    case Page::Change::Rects:
+        updateRects();
+        break;
+    case Page::Change::Curves:
+        updateCurves();
+        break;
+    }
 }
 
-void PageScene::initPageRect()
+void PageScene::updateImage()
 {
-    QRectF rect;
-    if (mCroprect) {
-        rect = mCroprect->rect();
-    } else if (mPixmap) {
-        rect = mPixmap->boundingRect();
-    }
+    PageImagePtr image;
+    if (mPage) { image = mPage->pageImage(); }
 
-    if (!mPagerect) {
-        mPagerect = new QGraphicsRectItem(rect);
-        QPen pen(Qt::black, 1);
-        pen.setCosmetic(true);
-        mPagerect->setPen(pen);
-
-        // Add the item to the scene
-        this->addItem(mPagerect);
-        mPagerect->setZValue(1);
+    if (image != mImage) {
+        mPixmap->setPixmap(QPixmap());
+        if (mImage) { mImage->release(); }
+        mImage = image;
+        if (mImage) {
+            mPixmap->setTransform(QTransform());
+            mPixmap->setTransformationMode(Qt::FastTransformation);
+            mPixmap->setPixmap(mImage->acquire());
+        }
+    }
+    if (mImage) { return; }
+
+    if (mPage && mPage->hasPreview()) {
+        QPixmap preview = QPixmap::fromImage(mPage->preview());
+        QRectF rect = mPage->imageRect();
+        mPixmap->setPixmap(preview);
+        mPixmap->setTransformationMode(Qt::SmoothTransformation);
+        mPixmap->setTransform(QTransform::fromScale(
+                rect.width() / (qreal)preview.width(),
+                rect.height() / (qreal)preview.height()));
     } else {
-        mPagerect->setRect(rect);
+        mPixmap->setTransform(QTransform());
+        mPixmap->setPixmap(QPixmap());
     }
 }
 
-void PageScene::initCropRect()
+void PageScene::updateRects()
 {
-    QRectF rect;
-    if (mPixmap) {
-        rect = mPixmap->boundingRect();
+    if (!mPage) {
+        mPagerect->setRect(QRectF());
+        mCroprect->hide();
+        mZoomrect->hide();
+        return;
     }
-    mCroprect = new QGraphicsRectItem(rect);
-    QPen pen(Qt::blue, 2);
-    pen.setCosmetic(true);
-    mCroprect->setPen(pen);
-    QColor fillColor("#676cf5");
-    fillColor.setAlphaF(0.5);
-    mCroprect->setBrush(fillColor); // Set semi-transparent blue fill
 
-    // Add the item to the scene
-    this->addItem(mCroprect);
-    mCroprect->setZValue(1);
-    mCroprect->hide();
+    mPagerect->setRect(mPage->getPageRect());
+    mCroprect->setRect(mPage->getCropRect());
+    mCroprect->setVisible(mPage->isCropRectShown());
+    mZoomrect->setRect(mPage->getZoomRect());
+    mZoomrect->setVisible(mPage->isZoomRectShown());
 }
 
-void PageScene::initZoomRect()
+void PageScene::updateCurves()
 {
-    mZoomrect = new QGraphicsRectItem();
-    QPen pen(Qt::blue, 2);
-    pen.setCosmetic(true);
-    mZoomrect->setPen(pen);
+    DrawCurvePtr live;
+    QList<DrawCurvePtr> curves;
+    if (mPage) {
+        live = mPage->liveCurve();
+        curves = mPage->drawCurves();
+        curves.removeAll(live);
+    }
 
-    // Add the item to the scene
-    this->addItem(mZoomrect);
-    mZoomrect->setZValue(1);
-    mZoomrect->hide();
+    if (live != mLiveCurve) {
+        if (mLiveCurve && (mLiveCurve->scenePathItem()->scene() == this)) {
+            this->removeItem(mLiveCurve->scenePathItem());
+        }
+        mLiveCurve = live;
+        if (mLiveCurve) {
+            this->addItem(mLiveCurve->scenePathItem());
+        }
+    }
+
+    mAnnotations->setCurves(curves, mPage ? mPage->annotationCache()
+                                          : AnnotationCachePtr());
 }
@@ -21,44 +21,42 @@
 #ifndef PAGESCENE_H
 #define PAGESCENE_H
 
-#include "drawcurve.h"
+#include "annotationlayer.h"
+#include "page.h"
 
 #include <QGraphicsScene>
 
+// Scene showing a single page. Scenes are reused for different pages (see
+// ScenePool): setPage() binds a page, after which the scene follows changes
+// made to the page.
 class PageScene : public QGraphicsScene
 {
 public:
     PageScene();
+    ~PageScene();
 
-    QGraphicsPixmapItem* mPixmap = nullptr;
-    void setImage(QImage image);
-
-    void setPageRectToCropRect();
-    QRectF getPageRect();
+    void setPage(PagePtr page);
+    PagePtr page();
 
-    void setCropRect(QRectF rect);
-    QRectF getCropRect();
-    void showCropRect(bool show);
+    // Called by the bound page when it changes
+    void pageChanged(Page::Change change);
 
-    void setZoomRect(QRectF rect);
-    QRectF getZoomRect();
-    void showZoomRect(bool show);
+private:
+    PagePtr mPage;
 
-    void addDrawCurve(DrawCurvePtr drawCurve);
-    QList<DrawCurvePtr> drawCurves();
-    void removeDrawCurve(DrawCurvePtr drawCurve);
+    // Image acquired by this scene, for as long as it is shown
+    PageImagePtr mImage;
+    QGraphicsPixmapItem* mPixmap = nullptr;
+    void updateImage();
 
-private:
     QGraphicsRectItem* mPagerect = nullptr;
-    void initPageRect();
-
     QGraphicsRectItem* mCroprect = nullptr;
-    void initCropRect();
-
     QGraphicsRectItem* mZoomrect = nullptr;
-    void initZoomRect();
+    void updateRects();
 
-    QList<DrawCurvePtr> mDrawCurves;
+    DrawCurvePtr mLiveCurve;
+    AnnotationLayer* mAnnotations = nullptr;
+    void updateCurves();
 };
 
 typedef QSharedPointer<PageScene> PageScenePtr;
@@ -0,0 +1,481 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "pdfregistry.h"
+#include "gidfile.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QSet>
+#include <QThread>
+#include <QtConcurrent>
+
+PdfSource::PdfSource(QString filepath, QByteArray contentHash)
+    : mFilepath(filepath), mContentHash(contentHash)
+{
+    // Sources may be created on a worker thread (see PdfRegistry::prepare()),
+    // but are owned by the GUI thread
+    QThread* guiThread = QCoreApplication::instance()->thread();
+
+    mFile = MappedFile::open(filepath);
+    if (!mFile->isOpen()) {
+        mError = QPdfDocument::FileNotFoundError;
+        mPdf.moveToThread(guiThread);
+        return;
+    }
+    mDevice.reset(mFile->createDevice());
+    mPdf.load(mDevice.data());
+    mError = mPdf.error();
+
+    for (int i = 0; i < mPdf.pageCount(); i++) {
+        mPageSizes.append(mPdf.pageSize(i));
+    }
+
+    mPdf.moveToThread(guiThread);
+    mDevice->moveToThread(guiThread);
+}
+
+QString PdfSource::filepath()
+{
+    return mFilepath;
+}
+
+QByteArray PdfSource::contentHash()
+{
+    return mContentHash;
+}
+
+QPdfDocument::DocumentError PdfSource::error()
+{
+    return mError;
+}
+
+int PdfSource::pageCount()
+{
+    return mPageSizes.count();
+}
+
+QSizeF PdfSource::pageSize(int page)
+{
+    return mPageSizes.value(page);
+}
+
+QSize PdfSource::renderSizeFor(QSizeF pageSize)
+{
+    return pageSize.toSize() * renderScale;
+}
+
+QSize PdfSource::renderSize(int page)
+{
+    return renderSizeFor(pageSize(page));
+}
+
+QList<int> PdfSource::pagesInRange(QString range)
+{
+    QList<int> pages;
+    int count = pageCount();
+
+    if (range.trimmed().isEmpty()) {
+        for (int i = 0; i < count; i++) {
+            pages.append(i);
+        }
+        return pages;
+    }
+
+    foreach (QString part, range.split(",")) {
+        if (part.trimmed().isEmpty()) { continue; }
+        QStringList bounds = part.split("-");
+        if (bounds.count() > 2) { continue; }
+
+        bool ok = false;
+        int first = bounds.value(0).trimmed().toInt(&ok);
+        if (!ok) { continue; }
+        int last = first;
+        if (bounds.count() == 2) {
+            last = bounds.value(1).trimmed().toInt(&ok);
+            if (!ok) { continue; }
+        }
+
+        // Limit to the pages that exist, so huge numbers don't loop for long
+        first = qMax(first, 1);
+        last = qMin(last, count);
+        for (int p = first; p <= last; p++) {
+            pages.append(p - 1);
+        }
+    }
+
+    return pages;
+}
+
+PageImagePtr PdfSource::page(int page)
+{
+    // The cache lock is not held while rendering, so the GUI thread never
+    // waits for a render to use the cache. Renders are serialised by
+    // mRenderMutex, which is always taken before (never while holding) mMutex.
+    QMutexLocker renderLocker(&mRenderMutex);
+    QMutexLocker locker(&mMutex);
+
+    PageImagePtr image = mPages.value(page);
+    if (image) { return image; }
+    ImageFilters::RenderOptions options = mRenderOptions;
+    int generation = mOptionsGeneration;
+    locker.unlock();
+
+    QImage rendered = mPdf.render(page, renderSize(page));
+    renderLocker.unlock();
+
+    image.reset(new PageImage(ImageFilters::process(rendered, options)));
+    image = PageImageStore::intern(image);
+    locker.relock();
+
+    if (generation == mOptionsGeneration) {
+        // Another thread may have rendered it meanwhile
+        if (mPages.contains(page)) { return mPages.value(page); }
+        mPages.insert(page, image);
+        mPreviews.remove(page);
+    }
+    return image;
+}
+
+PageImagePtr PdfSource::cachedPage(int page)
+{
+    QMutexLocker locker(&mMutex);
+    return mPages.value(page);
+}
+
+QImage PdfSource::renderUncached(int page)
+{
+    QMutexLocker renderLocker(&mRenderMutex);
+    mMutex.lock();
+    ImageFilters::RenderOptions options = mRenderOptions;
+    mMutex.unlock();
+
+    QImage rendered = mPdf.render(page, renderSize(page));
+    renderLocker.unlock();
+
+    return ImageFilters::process(rendered, options);
+}
+
+void PdfSource::insertPage(int page, PageImagePtr image)
+{
+    QMutexLocker locker(&mMutex);
+    if (!image || mPages.contains(page)) { return; }
+    mPages.insert(page, PageImageStore::intern(image));
+    mPreviews.remove(page);
+}
+
+void PdfSource::removePage(int page)
+{
+    QMutexLocker locker(&mMutex);
+    mPages.remove(page);
+}
+
+QImage PdfSource::preview(int page)
+{
+    // Locking as in page()
+    QMutexLocker renderLocker(&mRenderMutex);
+    QMutexLocker locker(&mMutex);
+
+    if (mPreviews.contains(page)) { return mPreviews.value(page); }
+    ImageFilters::RenderOptions options = mRenderOptions;
+    int generation = mOptionsGeneration;
+    locker.unlock();
+
+    QImage rendered = mPdf.render(page, renderSize(page) / previewDivisor);
+    renderLocker.unlock();
+
+    QImage image = ImageFilters::process(rendered, options);
+    locker.relock();
+
+    if ((generation == mOptionsGeneration) && !mPages.contains(page)) {
+        mPreviews.insert(page, image);
+    }
+    return image;
+}
+
+QImage PdfSource::cachedPreview(int page)
+{
+    QMutexLocker locker(&mMutex);
+    return mPreviews.value(page);
+}
+
+void PdfSource::setRenderOptions(ImageFilters::RenderOptions options)
+{
+    QMutexLocker locker(&mMutex);
+    mRenderOptions = options;
+    mOptionsGeneration++;
+    mPages.clear();
+    mPreviews.clear();
+}
+
+PdfSourcePtr PdfRegistry::open(QString filepath)
+{
+    removeClosed();
+
+    QString key = pathKey(filepath);
+    if (key.isEmpty()) {
+        // File doesn't exist. Still create a source so errors are reported.
+        PdfSourcePtr source(new PdfSource(filepath, QByteArray()));
+        source->setRenderOptions(mRenderOptions);
+        return source;
+    }
+    QString canonical = QFileInfo(filepath).canonicalFilePath();
+
+    PdfSourcePtr source = mByPath.value(key).toStrongRef();
+    if (source) { return source; }
+
+    QByteArray hash = hashFile(canonical);
+    saveHashes();
+    if (!hash.isEmpty()) {
+        source = mByHash.value(hash).toStrongRef();
+        if (source) {
+            mByPath.insert(key, source);
+            return source;
+        }
+    }
+
+    source.reset(new PdfSource(canonical, hash));
+    source->setRenderOptions(mRenderOptions);
+    mByPath.insert(key, source);
+    if (!hash.isEmpty()) {
+        mByHash.insert(hash, source);
+    }
+    return source;
+}
+
+QStringList PdfRegistry::unopened(QStringList filepaths)
+{
+    removeClosed();
+
+    QStringList ret;
+    foreach (QString filepath, filepaths) {
+        QString key = pathKey(filepath);
+        if (key.isEmpty() || mByPath.contains(key)) { continue; }
+        if (!ret.contains(filepath)) { ret.append(filepath); }
+    }
+    return ret;
+}
+
+struct PrepareItem {
+    QString filepath;
+    QString canonical;
+    QString pathKey;
+    QByteArray hash;
+};
+
+static PrepareItem hashItem(const PrepareItem& item)
+{
+    PrepareItem ret = item;
+    ret.hash = PdfRegistry::hashFile(item.canonical);
+    return ret;
+}
+
+static PdfSourcePtr createSource(const PrepareItem& item)
+{
+    return PdfSourcePtr(new PdfSource(item.canonical, item.hash));
+}
+
+QList<PdfRegistry::Prepared> PdfRegistry::prepare(QStringList filepaths)
+{
+    QList<PrepareItem> items;
+    foreach (QString filepath, filepaths) {
+        PrepareItem item;
+        item.filepath = filepath;
+        item.canonical = QFileInfo(filepath).canonicalFilePath();
+        item.pathKey = pathKey(filepath);
+        if (item.pathKey.isEmpty()) { continue; }
+        items.append(item);
+    }
+
+    // Hash all files, then open each distinct file once
+    items = QtConcurrent::blockingMapped<QList<PrepareItem>>(items, hashItem);
+    saveHashes();
+
+    QList<PrepareItem> distinct;
+    QSet<QByteArray> hashes;
+    foreach (const PrepareItem& item, items) {
+        if (!item.hash.isEmpty() && hashes.contains(item.hash)) { continue; }
+        hashes.insert(item.hash);
+        distinct.append(item);
+    }
+    QList<PdfSourcePtr> sources = QtConcurrent::blockingMapped<QList<PdfSourcePtr>>(
+                distinct, createSource);
+
+    QList<Prepared> ret;
+    foreach (const PrepareItem& item, items) {
+        Prepared p;
+        p.pathKey = item.pathKey;
+        for (int i = 0; i < distinct.count(); i++) {
+            bool same = item.hash.isEmpty() ? (distinct[i].pathKey == item.pathKey)
+                                            : (distinct[i].hash == item.hash);
+            if (same) {
+                p.source = sources[i];
+                break;
+            }
+        }
+        ret.append(p);
+    }
+    return ret;
+}
+
+void PdfRegistry::add(QList<Prepared> prepared)
+{
+    removeClosed();
+
+    foreach (Prepared p, prepared) {
+        if (!p.source || mByPath.contains(p.pathKey)) { continue; }
+
+        // Use a source opened in the meantime for the same content, if any
+        QByteArray hash = p.source->contentHash();
+        PdfSourcePtr source;
+        if (!hash.isEmpty()) {
+            source = mByHash.value(hash).toStrongRef();
+        }
+        if (!source) {
+            source = p.source;
+            source->setRenderOptions(mRenderOptions);
+            if (!hash.isEmpty()) {
+                mByHash.insert(hash, source);
+            }
+        }
+        mByPath.insert(p.pathKey, source);
+    }
+}
+
+void PdfRegistry::setRenderOptions(ImageFilters::RenderOptions options)
+{
+    mRenderOptions = options;
+
+    removeClosed();
+    foreach (QWeakPointer<PdfSource> weak, mByPath.values()) {
+        PdfSourcePtr source = weak.toStrongRef();
+        if (source) {
+            source->setRenderOptions(options);
+        }
+    }
+}
+
+// Cached file hashes, see PdfRegistry::hashFile()
+static QMutex hashCacheMutex;
+static QHash<QString, QByteArray> hashCache;
+static bool hashCacheLoaded = false;
+static bool hashCacheModified = false;
+
+static QString hashCacheFilepath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + "/pdfhashes";
+}
+
+static QString hashCacheKey(QFileInfo fi)
+{
+    return QString("%1|%2|%3").arg(fi.canonicalFilePath()).arg(fi.size())
+            .arg(fi.lastModified().toMSecsSinceEpoch());
+}
+
+// Called with hashCacheMutex locked
+static void loadHashCache()
+{
+    if (hashCacheLoaded) { return; }
+    hashCacheLoaded = true;
+
+    GidFile::ReadResult r = GidFile::read(hashCacheFilepath());
+    if (!r.result.success) { return; }
+    QDataStream stream(r.data);
+    stream.setVersion(QDataStream::Qt_5_0);
+    QHash<QString, QByteArray> hashes;
+    stream >> hashes;
+    if (stream.status() != QDataStream::Ok) { return; }
+
+    // Forget files that have since changed or been removed
+    QHashIterator<QString, QByteArray> i(hashes);
+    while (i.hasNext()) {
+        i.next();
+        QString path = i.key().section('|', 0, -3);
+        if (hashCacheKey(QFileInfo(path)) == i.key()) {
+            hashCache.insert(i.key(), i.value());
+        } else {
+            hashCacheModified = true;
+        }
+    }
+}
+
+QByteArray PdfRegistry::hashFile(QString filepath)
+{
+    QFileInfo fi(filepath);
+    if (!fi.exists()) { return QByteArray(); }
+    QString key = hashCacheKey(fi);
+    {
+        QMutexLocker locker(&hashCacheMutex);
+        loadHashCache();
+        if (hashCache.contains(key)) { return hashCache.value(key); }
+    }
+
+    MappedFilePtr f = MappedFile::open(filepath);
+    if (!f->isOpen()) { return QByteArray(); }
+    QByteArray hash = QCryptographicHash::hash(f->data(), QCryptographicHash::Md5);
+
+    QMutexLocker locker(&hashCacheMutex);
+    hashCache.insert(key, hash);
+    hashCacheModified = true;
+    return hash;
+}
+
+void PdfRegistry::saveHashes()
+{
+    QMutexLocker locker(&hashCacheMutex);
+    if (!hashCacheModified) { return; }
+    hashCacheModified = false;
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << hashCache;
+    QDir().mkpath(QFileInfo(hashCacheFilepath()).path());
+    GidFile::write(hashCacheFilepath(), data);
+}
+
+QString PdfRegistry::pathKey(QString filepath)
+{
+    QFileInfo fi(filepath);
+    QString canonical = fi.canonicalFilePath();
+    if (canonical.isEmpty()) { return QString(); }
+
+    // Modification time is included so a changed file is opened again
+    return QString("%1|%2").arg(canonical)
+            .arg(fi.lastModified().toMSecsSinceEpoch());
+}
+
+void PdfRegistry::removeClosed()
+{
+    QMutableHashIterator<QString, QWeakPointer<PdfSource>> i(mByPath);
+    while (i.hasNext()) {
+        if (i.next().value().isNull()) { i.remove(); }
+    }
+    QMutableHashIterator<QByteArray, QWeakPointer<PdfSource>> j(mByHash);
+    while (j.hasNext()) {
+        if (j.next().value().isNull()) { j.remove(); }
+    }
+}
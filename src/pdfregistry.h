@@ -0,0 +1,159 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* PdfRegistry
+ *
+ * Keeps track of open PDF files so that documents referring to the same file
+ * (e.g. a reprise, or different parts of one songbook) share a single open
+ * QPdfDocument and a single set of rendered page images. Each document still
+ * has its own pages with their own crop rectangles and annotations.
+ *
+ * Sources are looked up by canonical file path (and modification time) first
+ * and then by content hash, so identical files at different paths are also
+ * shared. The registry only holds weak references; a source is closed when the
+ * last document using it is removed.
+ *
+ * Pages are rendered by the RenderScheduler thread. PdfSource methods may be
+ * called from any thread.
+ *
+ * When a session is opened, its files are opened in parallel with prepare()
+ * before the documents are loaded, see MainWindow::loadPdfs().
+ */
+
+#ifndef PDFREGISTRY_H
+#define PDFREGISTRY_H
+
+#include "imagefilters.h"
+#include "mappedfile.h"
+#include "pageimage.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QPdfDocument>
+#include <QSharedPointer>
+#include <QWeakPointer>
+
+class PdfSource
+{
+public:
+    PdfSource(QString filepath, QByteArray contentHash);
+
+    // Scale at which pages are rendered, relative to the PDF page size
+    static const int renderScale = 2;
+    static QSize renderSizeFor(QSizeF pageSize);
+
+    QString filepath();
+    QByteArray contentHash();
+    QPdfDocument::DocumentError error();
+    int pageCount();
+    QSizeF pageSize(int page);
+    // Size of the rendered page image
+    QSize renderSize(int page);
+
+    // Returns the 0-based page numbers in a 1-based page range such as
+    // "1-3, 7, 10-12". An empty range means all pages.
+    QList<int> pagesInRange(QString range);
+
+    // Rendered page. Rendered on first request and shared thereafter. This
+    // blocks while rendering, see RenderScheduler.
+    PageImagePtr page(int page);
+    // Rendered page if already rendered, otherwise null
+    PageImagePtr cachedPage(int page);
+    // Renders a page with the current render options without storing it, for
+    // a one-off look at pages that aren't rendered (e.g. auto crop)
+    QImage renderUncached(int page);
+    // Stores a page rendered earlier (e.g. in the startup snapshot) if the page
+    // hasn't been rendered yet. The image must have been rendered with the
+    // current render options.
+    void insertPage(int page, PageImagePtr image);
+    // Drops a rendered page to free memory. It is rendered again when next
+    // requested.
+    void removePage(int page);
+
+    // Quick low resolution render shown until the page has been rendered.
+    // Previews are dropped once the page is rendered.
+    static const int previewDivisor = 4;
+    QImage preview(int page);
+    QImage cachedPreview(int page);
+
+    // Changing the render options discards pages rendered so far
+    void setRenderOptions(ImageFilters::RenderOptions options);
+
+private:
+    QString mFilepath;
+    QByteArray mContentHash;
+    // The PDF is read through a read-only memory mapping of the file
+    MappedFilePtr mFile;
+    QScopedPointer<QIODevice> mDevice;
+    QPdfDocument mPdf;
+    QPdfDocument::DocumentError mError = QPdfDocument::NoError;
+    // Read once when loading, so page geometry never waits for a render
+    QVector<QSizeF> mPageSizes;
+    QHash<int, PageImagePtr> mPages;
+    QHash<int, QImage> mPreviews;
+    ImageFilters::RenderOptions mRenderOptions;
+    // Incremented when render options change, so renders started with the
+    // old options are not stored
+    int mOptionsGeneration = 0;
+    // mMutex protects the cached pages and options, mRenderMutex the PDF
+    QMutex mMutex;
+    QMutex mRenderMutex;
+};
+
+typedef QSharedPointer<PdfSource> PdfSourcePtr;
+
+
+class PdfRegistry
+{
+public:
+    PdfSourcePtr open(QString filepath);
+
+    // Opening a source reads the page sizes, and the whole file to hash it if
+    // its hash isn't cached yet (see hashFile()). prepare() does this for several files in parallel and may be called from
+    // any thread. add() registers the prepared sources (in the GUI thread),
+    // after which open() returns them without reading the files again.
+    struct Prepared {
+        QString pathKey;
+        PdfSourcePtr source;
+    };
+    QStringList unopened(QStringList filepaths);
+    static QList<Prepared> prepare(QStringList filepaths);
+    void add(QList<Prepared> prepared);
+
+    // Render options of all open and future sources
+    void setRenderOptions(ImageFilters::RenderOptions options);
+
+    // Content hash of a file. Hashes are cached on disk, keyed by canonical
+    // path, size and modification time, so a file is only read in full the
+    // first time it is opened. May be called from any thread.
+    static QByteArray hashFile(QString filepath);
+    // Writes new cached hashes to disk
+    static void saveHashes();
+
+private:
+    // Canonical path and modification time, or empty if the file doesn't exist
+    static QString pathKey(QString filepath);
+    QHash<QString, QWeakPointer<PdfSource>> mByPath;
+    QHash<QByteArray, QWeakPointer<PdfSource>> mByHash;
+    ImageFilters::RenderOptions mRenderOptions;
+    void removeClosed();
+};
+
+#endif // PDFREGISTRY_H
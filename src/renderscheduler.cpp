@@ -0,0 +1,131 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "renderscheduler.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <algorithm>
+
+class RenderWorker : public QThread
+{
+public:
+    RenderWorker(RenderScheduler* scheduler) : scheduler(scheduler) {}
+
+protected:
+    void run() override
+    {
+        RenderScheduler::Job job;
+        while (scheduler->takeJob(&job)) {
+            PdfSourcePtr source = job.source.toStrongRef();
+            if (!source) { continue; }
+            if (source->cachedPage(job.pdfPage)) {
+                scheduler->releaseSource(std::move(source));
+                continue;
+            }
+
+            QElapsedTimer timer;
+            timer.start();
+            if (job.preview) {
+                if (!source->cachedPreview(job.pdfPage).isNull()) {
+                    scheduler->releaseSource(std::move(source));
+                    continue;
+                }
+                source->preview(job.pdfPage);
+            } else {
+                source->page(job.pdfPage);
+            }
+            scheduler->jobDone(job, std::move(source), timer.elapsed());
+        }
+    }
+
+private:
+    RenderScheduler* scheduler;
+};
+
+
+RenderScheduler::RenderScheduler(QObject* parent)
+    : QObject{parent}
+{
+    mWorker = new RenderWorker(this);
+    mWorker->start();
+}
+
+RenderScheduler::~RenderScheduler()
+{
+    mMutex.lock();
+    mStop = true;
+    mQueue.clear();
+    mCondition.wakeAll();
+    mMutex.unlock();
+
+    mWorker->wait();
+    delete mWorker;
+}
+
+void RenderScheduler::setJobs(QList<Job> jobs)
+{
+    std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b)
+    {
+        return a.priority < b.priority;
+    });
+
+    QMutexLocker locker(&mMutex);
+    mQueue = jobs;
+    mCondition.wakeAll();
+}
+
+void RenderScheduler::cancelAll()
+{
+    QMutexLocker locker(&mMutex);
+    mQueue.clear();
+}
+
+bool RenderScheduler::takeJob(Job* job)
+{
+    QMutexLocker locker(&mMutex);
+
+    while (mQueue.isEmpty() && !mStop) {
+        mCondition.wait(&mMutex);
+    }
+    if (mStop) { return false; }
+
+    *job = mQueue.takeFirst();
+    return true;
+}
+
+void RenderScheduler::jobDone(Job job, PdfSourcePtr source, qint64 renderMs)
+{
+    // Called from worker thread. The source reference is handed to the GUI
+    // thread, where the source is then released.
+    QMetaObject::invokeMethod(this, [=]()
+    {
+        emit pageRendered(source.data(), job.pdfPage, job.preview,
+                          (int)job.priority, renderMs);
+    }, Qt::QueuedConnection);
+}
+
+void RenderScheduler::releaseSource(PdfSourcePtr source)
+{
+    // Called from worker thread. The source may hold the last reference and
+    // its PDF document belongs to the GUI thread, so release it there.
+    QMetaObject::invokeMethod(this, [source]() {}, Qt::QueuedConnection);
+}
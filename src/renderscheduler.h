@@ -0,0 +1,92 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* RenderScheduler
+ *
+ * Renders pages on a background thread, most urgent first.
+ *
+ * Each page render is a job with a priority. The GUI replaces the whole job
+ * list with setJobs() on every navigation, so jobs for pages that are no longer
+ * relevant are cancelled and the others are re-prioritised. Jobs are taken in
+ * priority order, so a visible page is only ever waiting for the one render
+ * that is already in progress, never for queued bulk work.
+ *
+ * A single render thread is used, as QtPdf serialises all PDF library calls
+ * with a global lock and more threads would not render faster.
+ *
+ * A job can also be for a quick low resolution preview of a page
+ * (PdfSource::preview()), to be shown until the page itself is rendered.
+ *
+ * pageRendered() is emitted in the GUI thread once a page (or preview) has
+ * been rendered and is available from PdfSource::cachedPage() (or
+ * PdfSource::cachedPreview()).
+ */
+
+#ifndef RENDERSCHEDULER_H
+#define RENDERSCHEDULER_H
+
+#include "pdfregistry.h"
+
+#include <QMutex>
+#include <QObject>
+#include <QWaitCondition>
+
+class RenderWorker;
+
+class RenderScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RenderScheduler(QObject* parent = nullptr);
+    ~RenderScheduler();
+
+    enum class Priority { Visible, NextTurn, Prefetch, Background };
+
+    struct Job {
+        QWeakPointer<PdfSource> source;
+        int pdfPage = 0;
+        Priority priority = Priority::Background;
+        bool preview = false;
+    };
+
+    // Replace all queued jobs. Jobs are taken in priority order and in list
+    // order within a priority.
+    void setJobs(QList<Job> jobs);
+    void cancelAll();
+
+signals:
+    void pageRendered(PdfSource* source, int pdfPage, bool preview,
+                      int priority, qint64 renderMs);
+
+private:
+    friend class RenderWorker;
+
+    QMutex mMutex;
+    QWaitCondition mCondition;
+    QList<Job> mQueue;
+    bool mStop = false;
+    bool takeJob(Job* job);
+    void jobDone(Job job, PdfSourcePtr source, qint64 renderMs);
+    void releaseSource(PdfSourcePtr source);
+
+    RenderWorker* mWorker = nullptr;
+};
+
+#endif // RENDERSCHEDULER_H
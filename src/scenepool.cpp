@@ -0,0 +1,53 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "scenepool.h"
+
+ScenePool::ScenePool(int size)
+{
+    for (int i = 0; i < qMax(1, size); i++) {
+        mScenes.append(PageScenePtr(new PageScene()));
+    }
+}
+
+PageScene* ScenePool::sceneFor(PagePtr page)
+{
+    if (!page) { return nullptr; }
+
+    int index = mScenes.count() - 1;
+    for (int i = 0; i < mScenes.count(); i++) {
+        if (mScenes[i]->page() == page) {
+            index = i;
+            break;
+        }
+    }
+
+    PageScenePtr scene = mScenes.takeAt(index);
+    scene->setPage(page);
+    mScenes.prepend(scene);
+    return scene.data();
+}
+
+void ScenePool::unbindAll()
+{
+    foreach (PageScenePtr scene, mScenes) {
+        scene->setPage(PagePtr());
+    }
+}
@@ -0,0 +1,44 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef SCENEPOOL_H
+#define SCENEPOOL_H
+
+#include "pagescene.h"
+
+// Small fixed set of page scenes that are bound to the pages being shown (or
+// about to be shown). The least recently used scene is rebound when a page
+// without a scene is requested, so the number of scenes does not grow with
+// the number of pages in the session.
+class ScenePool
+{
+public:
+    ScenePool(int size);
+
+    // Returns the scene bound to the page, binding one if needed
+    PageScene* sceneFor(PagePtr page);
+    void unbindAll();
+
+private:
+    // Most recently used first
+    QList<PageScenePtr> mScenes;
+};
+
+#endif // SCENEPOOL_H
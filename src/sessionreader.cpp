@@ -0,0 +1,419 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "sessionreader.h"
+#include "pdfregistry.h"
+
+#include <QtConcurrent>
+
+SessionReader::SessionReader(QByteArray data)
+    : mData(data)
+{
+    mPos = mData.constData();
+    mEnd = mPos + mData.size();
+}
+
+bool SessionReader::readDocument(Document* doc)
+{
+    if (!nextDocument()) { return false; }
+    return readDocumentObject(doc);
+}
+
+bool SessionReader::skipDocument(QByteArray* data)
+{
+    if (!nextDocument()) { return false; }
+
+    skipSpace();
+    const char* start = mPos;
+    if (!skipValue()) { return false; }
+    *data = QByteArray::fromRawData(start, mPos - start);
+    return true;
+}
+
+QList<SessionReader::Document> SessionReader::readDocuments(
+        QList<QByteArray> data, QString* error)
+{
+    QList<Result> results = QtConcurrent::blockingMapped<QList<Result>>(
+                data, readDocumentData);
+
+    // Documents up to the first one with an error
+    QList<Document> ret;
+    foreach (const Result& result, results) {
+        if (!result.error.isEmpty()) {
+            if (error) { *error = result.error; }
+            break;
+        }
+        ret.append(result.doc);
+    }
+    return ret;
+}
+
+SessionReader::Result SessionReader::readDocumentData(const QByteArray& data)
+{
+    Result ret;
+    SessionReader reader(data);
+    if (!reader.readDocumentObject(&ret.doc)) {
+        ret.error = reader.errorString();
+    }
+    return ret;
+}
+
+bool SessionReader::nextDocument()
+{
+    if (mFinished || !mError.isEmpty()) { return false; }
+
+    if (!mStarted) {
+        mStarted = true;
+        skipSpace();
+        // An empty file is an empty session
+        if (mPos == mEnd) {
+            mFinished = true;
+            return false;
+        }
+        if (!expect('[')) { return false; }
+    }
+
+    if (!nextElement(&mFirstDocument)) {
+        mFinished = true;
+        return false;
+    }
+    return true;
+}
+
+bool SessionReader::readDocumentObject(Document* doc)
+{
+    *doc = Document();
+    if (!expect('{')) { return false; }
+    QString key;
+    bool first = true;
+    while (nextMember(&key, &first)) {
+        bool ok = true;
+        if (key == "name") {
+            ok = readString(&doc->name);
+        } else if (key == "filepath") {
+            ok = readString(&doc->filepath);
+        } else if (key == "pageRange") {
+            ok = readString(&doc->pageRange);
+        } else if (key == "pages") {
+            ok = expect('[');
+            bool firstPage = true;
+            while (ok && nextElement(&firstPage)) {
+                PagePtr page(new Page());
+                ok = readPage(page.data());
+                doc->pages.append(page);
+            }
+        } else {
+            ok = skipValue();
+        }
+        if (!ok || !mError.isEmpty()) { return false; }
+    }
+    return mError.isEmpty();
+}
+
+QString SessionReader::errorString()
+{
+    return mError;
+}
+
+bool SessionReader::setError(QString error)
+{
+    if (mError.isEmpty()) {
+        mError = QString("%1 at offset %2").arg(error)
+                .arg(mPos - mData.constData());
+    }
+    return false;
+}
+
+void SessionReader::skipSpace()
+{
+    while ((mPos < mEnd) && ((*mPos == ' ') || (*mPos == '\n')
+                             || (*mPos == '\r') || (*mPos == '\t'))) {
+        mPos++;
+    }
+}
+
+bool SessionReader::peek(char c)
+{
+    skipSpace();
+    return (mPos < mEnd) && (*mPos == c);
+}
+
+bool SessionReader::expect(char c)
+{
+    if (!peek(c)) {
+        return setError(QString("Expected '%1'").arg(c));
+    }
+    mPos++;
+    return true;
+}
+
+bool SessionReader::nextMember(QString* key, bool* first)
+{
+    if (!mError.isEmpty()) { return false; }
+    if (peek('}')) {
+        mPos++;
+        return false;
+    }
+    if (!*first && !expect(',')) { return false; }
+    *first = false;
+    return readString(key) && expect(':');
+}
+
+bool SessionReader::nextElement(bool* first)
+{
+    if (!mError.isEmpty()) { return false; }
+    if (peek(']')) {
+        mPos++;
+        return false;
+    }
+    if (!*first && !expect(',')) { return false; }
+    *first = false;
+    return true;
+}
+
+bool SessionReader::readString(QString* string)
+{
+    if (!expect('"')) { return false; }
+
+    QByteArray utf8;
+    while (mPos < mEnd) {
+        // Copy runs of plain characters at once
+        const char* start = mPos;
+        while ((mPos < mEnd) && (*mPos != '"') && (*mPos != '\\')) { mPos++; }
+        utf8.append(start, mPos - start);
+        if (mPos == mEnd) { break; }
+
+        if (*mPos == '"') {
+            mPos++;
+            if (string) { *string = QString::fromUtf8(utf8); }
+            return true;
+        }
+
+        // Escape sequence
+        mPos++;
+        if (mPos == mEnd) { break; }
+        char c = *mPos++;
+        switch (c) {
+        case 'b': utf8.append('\b'); break;
+        case 'f': utf8.append('\f'); break;
+        case 'n': utf8.append('\n'); break;
+        case 'r': utf8.append('\r'); break;
+        case 't': utf8.append('\t'); break;
+        case 'u': {
+            QString chars;
+            bool ok = (mEnd - mPos >= 4);
+            if (ok) {
+                chars.append(QChar(QByteArray(mPos, 4).toUShort(&ok, 16)));
+                mPos += 4;
+            }
+            if (!ok) { return setError("Invalid unicode escape"); }
+            // Characters outside the BMP are escaped as surrogate pairs
+            if (chars.at(0).isHighSurrogate() && (mEnd - mPos >= 6)
+                    && (mPos[0] == '\\') && (mPos[1] == 'u')) {
+                ushort low = QByteArray(mPos + 2, 4).toUShort(&ok, 16);
+                if (ok && QChar::isLowSurrogate(low)) {
+                    chars.append(QChar(low));
+                    mPos += 6;
+                }
+            }
+            utf8.append(chars.toUtf8());
+            break;
+        }
+        default:
+            // \" \\ \/
+            utf8.append(c);
+        }
+    }
+    return setError("Unterminated string");
+}
+
+bool SessionReader::readNumber(double* number)
+{
+    skipSpace();
+    const char* start = mPos;
+    while ((mPos < mEnd) && (((*mPos >= '0') && (*mPos <= '9')) || (*mPos == '-')
+                             || (*mPos == '+') || (*mPos == '.')
+                             || (*mPos == 'e') || (*mPos == 'E'))) {
+        mPos++;
+    }
+    bool ok = false;
+    double value = QByteArray(start, mPos - start).toDouble(&ok);
+    if (!ok) {
+        mPos = start;
+        return setError("Expected number");
+    }
+    if (number) { *number = value; }
+    return true;
+}
+
+bool SessionReader::skipValue()
+{
+    skipSpace();
+    if (mPos == mEnd) { return setError("Expected value"); }
+
+    if (*mPos == '{') {
+        mPos++;
+        QString key;
+        bool first = true;
+        while (nextMember(&key, &first)) {
+            if (!skipValue()) { return false; }
+        }
+        return mError.isEmpty();
+    } else if (*mPos == '[') {
+        mPos++;
+        bool first = true;
+        while (nextElement(&first)) {
+            if (!skipValue()) { return false; }
+        }
+        return mError.isEmpty();
+    } else if (*mPos == '"') {
+        return readString(nullptr);
+    }
+
+    foreach (QByteArray literal, QList<QByteArray>({"true", "false", "null"})) {
+        if ((mEnd - mPos >= literal.size())
+                && (qstrncmp(mPos, literal.constData(), literal.size()) == 0)) {
+            mPos += literal.size();
+            return true;
+        }
+    }
+    return readNumber(nullptr);
+}
+
+bool SessionReader::readPage(Page* page)
+{
+    if (!expect('{')) { return false; }
+
+    QString key;
+    bool first = true;
+    while (nextMember(&key, &first)) {
+        bool ok = true;
+        if (key == "size") {
+            // Cached page size, so the page has its geometry before the PDF
+            // has been opened
+            QSizeF size;
+            ok = readSize(&size);
+            if (ok && !size.isEmpty()) {
+                page->setImageSize(PdfSource::renderSizeFor(size));
+            }
+        } else if (key == "rect") {
+            QRectF rect;
+            ok = readRect(&rect);
+            page->setCropRect(rect);
+            page->setPageRectToCropRect();
+        } else if (key == "drawCurves") {
+            ok = expect('[');
+            bool firstCurve = true;
+            while (ok && nextElement(&firstCurve)) {
+                DrawCurvePtr curve(new DrawCurve());
+                ok = readDrawCurve(curve.data());
+                page->addDrawCurve(curve);
+            }
+        } else {
+            ok = skipValue();
+        }
+        if (!ok) { return false; }
+    }
+    return mError.isEmpty();
+}
+
+bool SessionReader::readRect(QRectF* rect)
+{
+    if (!expect('{')) { return false; }
+
+    double x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    QString key;
+    bool first = true;
+    while (nextMember(&key, &first)) {
+        bool ok = true;
+        if (key == "xTopLeft") {
+            ok = readNumber(&x1);
+        } else if (key == "yTopLeft") {
+            ok = readNumber(&y1);
+        } else if (key == "xBotRight") {
+            ok = readNumber(&x2);
+        } else if (key == "yBotRight") {
+            ok = readNumber(&y2);
+        } else {
+            ok = skipValue();
+        }
+        if (!ok) { return false; }
+    }
+    *rect = QRectF(QPointF(x1, y1), QPointF(x2, y2));
+    return mError.isEmpty();
+}
+
+bool SessionReader::readSize(QSizeF* size)
+{
+    if (!expect('{')) { return false; }
+
+    double width = 0, height = 0;
+    QString key;
+    bool first = true;
+    while (nextMember(&key, &first)) {
+        bool ok = true;
+        if (key == "width") {
+            ok = readNumber(&width);
+        } else if (key == "height") {
+            ok = readNumber(&height);
+        } else {
+            ok = skipValue();
+        }
+        if (!ok) { return false; }
+    }
+    *size = QSizeF(width, height);
+    return mError.isEmpty();
+}
+
+bool SessionReader::readDrawCurve(DrawCurve* curve)
+{
+    if (!expect('{')) { return false; }
+
+    QString key;
+    bool first = true;
+    while (nextMember(&key, &first)) {
+        bool ok = true;
+        if (key == "points") {
+            ok = expect('[');
+            bool firstPoint = true;
+            while (ok && nextElement(&firstPoint)) {
+                ok = expect('{');
+                double x = 0, y = 0;
+                QString pointKey;
+                bool firstMember = true;
+                while (ok && nextMember(&pointKey, &firstMember)) {
+                    if (pointKey == "x") {
+                        ok = readNumber(&x);
+                    } else if (pointKey == "y") {
+                        ok = readNumber(&y);
+                    } else {
+                        ok = skipValue();
+                    }
+                }
+                ok = ok && mError.isEmpty();
+                if (ok) { curve->addPoint(QPointF(x, y)); }
+            }
+        } else {
+            ok = skipValue();
+        }
+        if (!ok) { return false; }
+    }
+    return mError.isEmpty();
+}
@@ -0,0 +1,103 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* SessionReader
+ *
+ * Reads a session (.sheets) file one document at a time, directly into pages
+ * and draw curves, without first building a JSON document of the whole file.
+ * The file data is typically a memory mapping of the file (see GidFile), so
+ * memory use is that of the session itself, and a document can be used as
+ * soon as its entry has been read. Documents can also be split off without
+ * being read and then read in parallel.
+ *
+ * The file is the JSON written by SessionWriter. Unknown members
+ * are skipped.
+ */
+
+#ifndef SESSIONREADER_H
+#define SESSIONREADER_H
+
+#include "page.h"
+
+#include <QByteArray>
+#include <QString>
+
+class SessionReader
+{
+public:
+    SessionReader(QByteArray data);
+
+    struct Document {
+        QString name;
+        QString filepath;
+        QString pageRange;
+        QList<PagePtr> pages;
+    };
+
+    // Reads the next document. Returns false at the end of the session or on
+    // an error.
+    bool readDocument(Document* doc);
+    // Returns the data of the next document without reading it, so documents
+    // can be read in parallel with readDocuments(). The data refers to the
+    // data passed to the constructor.
+    bool skipDocument(QByteArray* data);
+    // Reads documents from data returned by skipDocument() on the global
+    // thread pool. Returns the documents in order, up to the first error.
+    static QList<Document> readDocuments(QList<QByteArray> data, QString* error);
+    // Empty if no error occurred
+    QString errorString();
+
+private:
+    QByteArray mData;
+    const char* mPos = nullptr;
+    const char* mEnd = nullptr;
+    bool mStarted = false;
+    bool mFirstDocument = true;
+    bool mFinished = false;
+    QString mError;
+
+    struct Result {
+        Document doc;
+        QString error;
+    };
+    static Result readDocumentData(const QByteArray& data);
+    bool nextDocument();
+    bool readDocumentObject(Document* doc);
+
+    bool setError(QString error);
+    void skipSpace();
+    bool peek(char c);
+    bool expect(char c);
+    // Iterate over the members of an object or the elements of an array. The
+    // opening bracket must already have been read.
+    bool nextMember(QString* key, bool* first);
+    bool nextElement(bool* first);
+
+    bool readString(QString* string);
+    bool readNumber(double* number);
+    bool skipValue();
+
+    bool readPage(Page* page);
+    bool readRect(QRectF* rect);
+    bool readSize(QSizeF* size);
+    bool readDrawCurve(DrawCurve* curve);
+};
+
+#endif // SESSIONREADER_H
@@ -0,0 +1,83 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "sessionwriter.h"
+#include "drawcurve.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtConcurrent>
+
+QByteArray SessionWriter::toJson(QList<DocumentSnapshot> documents)
+{
+    QList<QByteArray> jdocs = QtConcurrent::blockingMapped<QList<QByteArray>>(
+                documents, documentJson);
+
+    QByteArray json("[\n");
+    for (int i = 0; i < jdocs.count(); i++) {
+        if (i > 0) { json.append(",\n"); }
+        json.append(jdocs[i]);
+    }
+    json.append("]\n");
+    return json;
+}
+
+QByteArray SessionWriter::documentJson(const DocumentSnapshot& doc)
+{
+    QJsonObject jdoc;
+    jdoc.insert("name", doc.name);
+    jdoc.insert("filepath", doc.filepath);
+    if (!doc.pageRange.isEmpty()) {
+        jdoc.insert("pageRange", doc.pageRange);
+    }
+
+    QJsonArray jpages;
+    foreach (const PageSnapshot& page, doc.pages) {
+        QJsonObject jpage;
+        jpage.insert("rect", rectToJson(page.cropRect));
+        if (!page.size.isEmpty()) {
+            QJsonObject jsize;
+            jsize.insert("width", page.size.width());
+            jsize.insert("height", page.size.height());
+            jpage.insert("size", jsize);
+        }
+
+        QJsonArray jcurves;
+        foreach (const QPainterPath& path, page.curves) {
+            jcurves.append(DrawCurve::pathToJson(path));
+        }
+        jpage.insert("drawCurves", jcurves);
+
+        jpages.append(jpage);
+    }
+    jdoc.insert("pages", jpages);
+
+    return QJsonDocument(jdoc).toJson().trimmed();
+}
+
+QJsonObject SessionWriter::rectToJson(QRectF rect)
+{
+    QJsonObject obj;
+    obj.insert("xTopLeft", rect.topLeft().x());
+    obj.insert("yTopLeft", rect.topLeft().y());
+    obj.insert("xBotRight", rect.bottomRight().x());
+    obj.insert("yBotRight", rect.bottomRight().y());
+    return obj;
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* SessionWriter
+ *
+ * Writes session (.sheets) files, as read by SessionReader.
+ *
+ * The documents are passed as a snapshot taken in the GUI thread. Each
+ * document is converted to JSON separately on the global thread pool and the
+ * results are joined in order.
+ */
+
+#ifndef SESSIONWRITER_H
+#define SESSIONWRITER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QList>
+#include <QPainterPath>
+#include <QRectF>
+#include <QString>
+
+class SessionWriter
+{
+public:
+    struct PageSnapshot {
+        QRectF cropRect;
+        // PDF page size, empty if not known
+        QSizeF size;
+        QList<QPainterPath> curves;
+    };
+
+    struct DocumentSnapshot {
+        QString name;
+        QString filepath;
+        QString pageRange;
+        QList<PageSnapshot> pages;
+    };
+
+    static QByteArray toJson(QList<DocumentSnapshot> documents);
+
+private:
+    static QByteArray documentJson(const DocumentSnapshot& doc);
+    static QJsonObject rectToJson(QRectF rect);
+};
+
+#endif // SESSIONWRITER_H
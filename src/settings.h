@@ -77,6 +77,10 @@ public:
     Setting fullscreen {"fullscreen", false};
     Setting iconsHorizontalSize {"iconsHorizontalSize", 54};
     Setting iconsVerticalSize {"iconsVerticalSize", 32};
+    Setting renderMode {"renderMode", 0};
+    Setting enhanceContrast {"enhanceContrast", false};
+    Setting viewMode {"viewMode", 0};
+    Setting breadcrumbScrub {"breadcrumbScrub", true};
 };
 
 #endif // SETTINGS_H
@@ -0,0 +1,122 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "startupsnapshot.h"
+#include "gidfile.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+// File identification and format version
+static const quint32 magic = 0x53485353;
+static const qint32 version = 2;
+
+bool StartupSnapshot::isValidFor(QString filepath)
+{
+    if (filepath.isEmpty() || (filepath != sessionFilepath)) { return false; }
+    QFileInfo fi(filepath);
+    return fi.exists()
+            && (fi.lastModified().toMSecsSinceEpoch() == sessionModifiedMs);
+}
+
+const StartupSnapshot::PageEntry* StartupSnapshot::currentPage()
+{
+    for (int i = 0; i < pages.count(); i++) {
+        if ((pages[i].docIndex == docIndex) && (pages[i].pageIndex == pageIndex)) {
+            return &pages[i];
+        }
+    }
+    return nullptr;
+}
+
+bool StartupSnapshot::save()
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    stream << magic << version;
+    stream << sessionFilepath << sessionModifiedMs << (qint32)docIndex
+           << (qint32)pageIndex << (qint32)renderMode << enhanceContrast;
+    stream << (qint32)pages.count();
+    foreach (const PageEntry& page, pages) {
+        stream << (qint32)page.docIndex << (qint32)page.pageIndex
+               << page.contentHash << (qint32)page.pdfPage << page.pageRect;
+        page.image->write(stream);
+    }
+
+    QDir().mkpath(QFileInfo(filepath()).path());
+    return GidFile::write(filepath(), data).success;
+}
+
+StartupSnapshot StartupSnapshot::load()
+{
+    StartupSnapshot ret;
+
+    if (!QFile::exists(filepath())) { return ret; }
+    GidFile::ReadResult r = GidFile::read(filepath());
+    if (!r.result.success) { return ret; }
+
+    QDataStream stream(r.data);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 fileMagic = 0;
+    qint32 fileVersion = 0;
+    stream >> fileMagic >> fileVersion;
+    if ((fileMagic != magic) || (fileVersion != version)) { return ret; }
+
+    StartupSnapshot snapshot;
+    qint32 docIndex = 0, pageIndex = 0, renderMode = 0, count = 0;
+    stream >> snapshot.sessionFilepath >> snapshot.sessionModifiedMs >> docIndex
+           >> pageIndex >> renderMode >> snapshot.enhanceContrast >> count;
+    snapshot.docIndex = docIndex;
+    snapshot.pageIndex = pageIndex;
+    snapshot.renderMode = renderMode;
+
+    for (int i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++) {
+        PageEntry page;
+        qint32 pageDocIndex = 0, pagePageIndex = 0, pdfPage = 0;
+        stream >> pageDocIndex >> pagePageIndex >> page.contentHash >> pdfPage
+               >> page.pageRect;
+        page.docIndex = pageDocIndex;
+        page.pageIndex = pagePageIndex;
+        page.pdfPage = pdfPage;
+        page.image = PageImage::read(stream);
+        if (!page.image) { break; }
+        snapshot.pages.append(page);
+    }
+    if (stream.status() != QDataStream::Ok) { return ret; }
+
+    return snapshot;
+}
+
+void StartupSnapshot::remove()
+{
+    QFile::remove(filepath());
+}
+
+QString StartupSnapshot::filepath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + "/startup.snapshot";
+}
@@ -0,0 +1,75 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* StartupSnapshot
+ *
+ * Saved when the app quits, so the next launch can show the last viewed page
+ * at once and read the session after the first frame.
+ *
+ * Holds the session file path (with its modification time, so a session that
+ * has changed since is ignored), the position in the session and the rendered
+ * images of the current page and its neighbours. The images are the page
+ * renders as stored in the render cache (uncropped, without drawings), with
+ * the PDF content hash, page and render options they were rendered with, so
+ * they can be used as renders once the session's PDFs are open.
+ */
+
+#ifndef STARTUPSNAPSHOT_H
+#define STARTUPSNAPSHOT_H
+
+#include "pageimage.h"
+
+#include <QList>
+#include <QRectF>
+#include <QString>
+
+class StartupSnapshot
+{
+public:
+    struct PageEntry {
+        int docIndex = 0;
+        int pageIndex = 0;
+        QByteArray contentHash;
+        int pdfPage = 0;
+        QRectF pageRect;
+        PageImagePtr image;
+    };
+
+    QString sessionFilepath;
+    qint64 sessionModifiedMs = 0;
+    int docIndex = 0;
+    int pageIndex = 0;
+    int renderMode = 0;
+    bool enhanceContrast = false;
+    QList<PageEntry> pages;
+
+    bool isValidFor(QString filepath);
+    // Entry of the page at the snapshot position, or null
+    const PageEntry* currentPage();
+
+    bool save();
+    static StartupSnapshot load();
+    static void remove();
+
+private:
+    static QString filepath();
+};
+
+#endif // STARTUPSNAPSHOT_H
@@ -0,0 +1,62 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "startuptimeline.h"
+
+#include <QElapsedTimer>
+
+static QElapsedTimer timer;
+static bool running = false;
+static QStringList events;
+
+void StartupTimeline::start()
+{
+    timer.start();
+    running = true;
+    events.clear();
+}
+
+void StartupTimeline::mark(QString event)
+{
+    if (!running) { return; }
+    events.append(QString("%1 ms: %2")
+                  .arg(timer.nsecsElapsed() / 1000000.0, 8, 'f', 1)
+                  .arg(event));
+}
+
+void StartupTimeline::finish()
+{
+    running = false;
+}
+
+bool StartupTimeline::isRunning()
+{
+    return running;
+}
+
+qint64 StartupTimeline::elapsedMs()
+{
+    return timer.elapsed();
+}
+
+QStringList StartupTimeline::lines()
+{
+    return events;
+}
@@ -0,0 +1,46 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* StartupTimeline
+ *
+ * Records the time of startup events relative to the start of main(), so the
+ * time to the first frame and to a fully loaded session can be checked in the
+ * debug console. Events are recorded until finish() is called.
+ */
+
+#ifndef STARTUPTIMELINE_H
+#define STARTUPTIMELINE_H
+
+#include <QStringList>
+
+class StartupTimeline
+{
+public:
+    static void start();
+    static void mark(QString event);
+    static void finish();
+    static bool isRunning();
+    // Time since start()
+    static qint64 elapsedMs();
+    // Recorded events, formatted for printing
+    static QStringList lines();
+};
+
+#endif // STARTUPTIMELINE_H
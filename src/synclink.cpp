@@ -0,0 +1,190 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "synclink.h"
+
+#include <chrono>
+
+const QString SyncLink::defaultServerName = "sheepmusic-sync";
+
+// Time to wait for a running leader when checking whether a name is in use
+static const int probeTimeoutMs = 500;
+
+SyncLink::SyncLink(QObject* parent)
+    : QObject{parent}
+{
+    mServer.setSocketOptions(QLocalServer::UserAccessOption);
+    connect(&mServer, &QLocalServer::newConnection,
+            this, &SyncLink::onNewConnection);
+
+    connect(&mSocket, &QLocalSocket::readyRead, this, &SyncLink::readSocket);
+    connect(&mSocket, &QLocalSocket::disconnected, this, [=]()
+    {
+        mReconnectTimer.start();
+    });
+    // Keep trying until the leader is running
+    mReconnectTimer.setInterval(1000);
+    mReconnectTimer.setSingleShot(true);
+    connect(&mReconnectTimer, &QTimer::timeout, this, &SyncLink::connectToLeader);
+}
+
+bool SyncLink::startLeader(QString name)
+{
+    mRole = Role::Leader;
+    mName = name;
+
+    // Don't take over the name of a running leader. Only remove the socket of
+    // a leader that did not exit cleanly (connection refused).
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(probeTimeoutMs)) {
+        mErrorString = QString("Name %1 is in use by another leader").arg(name);
+        return false;
+    }
+    if (probe.error() == QLocalSocket::ConnectionRefusedError) {
+        QLocalServer::removeServer(name);
+    }
+
+    if (!mServer.listen(name)) {
+        mErrorString = mServer.errorString();
+        return false;
+    }
+    return true;
+}
+
+void SyncLink::startFollower(QString name)
+{
+    mRole = Role::Follower;
+    mName = name;
+
+    connectToLeader();
+}
+
+SyncLink::Role SyncLink::role()
+{
+    return mRole;
+}
+
+QString SyncLink::errorString()
+{
+    return mErrorString;
+}
+
+void SyncLink::sendSession(QString filepath)
+{
+    if (mRole != Role::Leader) { return; }
+
+    mSessionMessage = QString("session %1\n").arg(filepath).toUtf8();
+    broadcast(mSessionMessage);
+}
+
+void SyncLink::sendPosition(Position position)
+{
+    if (mRole != Role::Leader) { return; }
+
+    QString msg = QString("pos %1 %2 %3 %4 %5 %6")
+            .arg(timestampNs())
+            .arg(position.doc)
+            .arg(position.page)
+            .arg(position.halfTurned ? 1 : 0)
+            .arg(position.nextDoc)
+            .arg(position.nextPage);
+    if (position.zoomed) {
+        QRectF r = position.zoomRect;
+        msg += QString(" %1 %2 %3 %4").arg(r.x()).arg(r.y())
+                .arg(r.width()).arg(r.height());
+    }
+    mPositionMessage = msg.toUtf8() + "\n";
+    broadcast(mPositionMessage);
+}
+
+qint64 SyncLink::timestampNs()
+{
+    // steady_clock is CLOCK_MONOTONIC on Linux, shared by all processes
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SyncLink::onNewConnection()
+{
+    while (QLocalSocket* socket = mServer.nextPendingConnection()) {
+        mFollowers.append(socket);
+        connect(socket, &QLocalSocket::disconnected, this, [=]()
+        {
+            mFollowers.removeAll(socket);
+            socket->deleteLater();
+        });
+
+        // Bring the new follower up to date
+        if (!mSessionMessage.isEmpty()) { socket->write(mSessionMessage); }
+        if (!mPositionMessage.isEmpty()) { socket->write(mPositionMessage); }
+        socket->flush();
+    }
+}
+
+void SyncLink::broadcast(QByteArray message)
+{
+    foreach (QLocalSocket* socket, mFollowers) {
+        socket->write(message);
+        // Write now instead of when control returns to the event loop
+        socket->flush();
+    }
+}
+
+void SyncLink::connectToLeader()
+{
+    mSocket.abort();
+    mSocket.connectToServer(mName);
+    if (!mSocket.waitForConnected(100)) {
+        mReconnectTimer.start();
+    }
+}
+
+void SyncLink::readSocket()
+{
+    while (mSocket.canReadLine()) {
+        parseLine(QString::fromUtf8(mSocket.readLine()).trimmed());
+    }
+}
+
+void SyncLink::parseLine(QString line)
+{
+    if (line.startsWith("session ")) {
+        emit sessionReceived(line.mid(QString("session ").length()));
+        return;
+    }
+
+    QStringList words = line.split(" ");
+    if ((words.value(0) != "pos") || (words.count() < 7)) { return; }
+
+    Position position;
+    position.sentNs = words[1].toLongLong();
+    position.doc = words[2].toInt();
+    position.page = words[3].toInt();
+    position.halfTurned = (words[4] == "1");
+    position.nextDoc = words[5].toInt();
+    position.nextPage = words[6].toInt();
+    if (words.count() >= 11) {
+        position.zoomed = true;
+        position.zoomRect = QRectF(words[7].toDouble(), words[8].toDouble(),
+                                   words[9].toDouble(), words[10].toDouble());
+    }
+    emit positionReceived(position);
+}
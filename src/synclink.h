@@ -0,0 +1,110 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* SyncLink
+ *
+ * Synchronised page turning between SheepMusic instances on one machine, e.g.
+ * one per musician screen, all showing the same session.
+ *
+ * The leader listens on a local socket and broadcasts its session file and
+ * every position change (document, page, zoom, half-page turn) to the
+ * connected followers, which show the same position. With each position the
+ * leader also announces the page that will most likely be shown next so
+ * followers can have it decoded in advance.
+ *
+ * Messages are text lines:
+ *
+ *     session <filepath>
+ *     pos <sentNs> <doc> <page> <halfTurned> <nextDoc> <nextPage> [<x> <y> <w> <h>]
+ *
+ * sentNs is a monotonic clock timestamp (timestampNs()), which is the same
+ * clock in all processes, so followers can measure the propagation latency.
+ * The zoom rectangle is only present when zoomed.
+ */
+
+#ifndef SYNCLINK_H
+#define SYNCLINK_H
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QRectF>
+#include <QTimer>
+
+class SyncLink : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SyncLink(QObject* parent = nullptr);
+
+    static const QString defaultServerName;
+
+    enum class Role { None, Leader, Follower };
+
+    struct Position {
+        int doc = -1;
+        int page = 0;
+        bool halfTurned = false;
+        bool zoomed = false;
+        QRectF zoomRect;
+        // Page expected to be shown next, -1 if none
+        int nextDoc = -1;
+        int nextPage = 0;
+        qint64 sentNs = 0;
+    };
+
+    bool startLeader(QString name);
+    void startFollower(QString name);
+    Role role();
+    QString errorString();
+
+    // Leader only
+    void sendSession(QString filepath);
+    void sendPosition(Position position);
+
+    static qint64 timestampNs();
+
+signals:
+    void sessionReceived(QString filepath);
+    void positionReceived(SyncLink::Position position);
+
+private:
+    Role mRole = Role::None;
+    QString mName;
+    QString mErrorString;
+
+    // Leader
+    QLocalServer mServer;
+    QList<QLocalSocket*> mFollowers;
+    // Last messages, sent to followers when they connect
+    QByteArray mSessionMessage;
+    QByteArray mPositionMessage;
+    void onNewConnection();
+    void broadcast(QByteArray message);
+
+    // Follower
+    QLocalSocket mSocket;
+    QTimer mReconnectTimer;
+    void connectToLeader();
+    void readSocket();
+    void parseLine(QString line);
+};
+
+#endif // SYNCLINK_H
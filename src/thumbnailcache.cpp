@@ -0,0 +1,283 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "thumbnailcache.h"
+#include "mappedfile.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPdfDocument>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThread>
+
+const QSize ThumbnailCache::thumbnailSize(160, 226);
+
+// Memory cache size in kilobytes
+static const int memoryCacheKb = 64 * 1024;
+// Disk cache size. Least recently used thumbnails are removed above this.
+static const qint64 diskCacheBytes = 128 * 1024 * 1024;
+
+// Name of the image file a reference file points to
+static QString refContentName(QString refPath)
+{
+    QFile file(refPath);
+    if (!file.open(QIODevice::ReadOnly)) { return QString(); }
+    return QString::fromUtf8(file.readAll()).trimmed();
+}
+
+
+class ThumbnailWorker : public QThread
+{
+public:
+    ThumbnailWorker(ThumbnailCache* cache) : cache(cache) {}
+
+protected:
+    void run() override
+    {
+        // The PDF document is created and used in this thread only. The last
+        // opened file is kept open as thumbnails are mostly requested in order.
+        QPdfDocument pdf;
+        QString openFilepath;
+        MappedFilePtr file;
+        QScopedPointer<QIODevice> device;
+
+        cache->pruneDiskCache();
+
+        ThumbnailCache::Job job;
+        while (cache->takeJob(&job)) {
+
+            QImage image;
+            QString contentPath = cache->readRef(job.refPath);
+            if (!contentPath.isEmpty()) {
+                image.load(contentPath);
+            }
+
+            if (image.isNull()) {
+                if (openFilepath != job.filepath) {
+                    // Read through a (shared) memory mapping of the file
+                    pdf.close();
+                    file = MappedFile::open(job.filepath);
+                    device.reset(file->createDevice());
+                    pdf.load(device.data());
+                    openFilepath = job.filepath;
+                }
+                QSizeF size = pdf.pageSize(job.pdfPage);
+                if (!size.isEmpty()) {
+                    QSize target = size.scaled(ThumbnailCache::thumbnailSize,
+                                               Qt::KeepAspectRatio).toSize();
+                    image = pdf.render(job.pdfPage, target);
+                    cache->store(job.refPath, image);
+                }
+            }
+
+            cache->jobDone(job, image);
+        }
+    }
+
+private:
+    ThumbnailCache* cache;
+};
+
+
+ThumbnailCache::ThumbnailCache(QObject* parent)
+    : QObject{parent}
+{
+    mImages.setMaxCost(memoryCacheKb);
+
+    mCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + "/thumbnails";
+    QDir().mkpath(mCacheDir + "/images");
+
+    mWorker = new ThumbnailWorker(this);
+    mWorker->start(QThread::LowPriority);
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    mMutex.lock();
+    mStop = true;
+    mQueue.clear();
+    mCondition.wakeAll();
+    mMutex.unlock();
+
+    mWorker->wait();
+    delete mWorker;
+}
+
+QImage ThumbnailCache::thumbnail(QString filepath, int pdfPage)
+{
+    QString key = thumbnailKey(filepath, pdfPage);
+
+    QImage* image = mImages.object(key);
+    if (image) { return *image; }
+
+    QMutexLocker locker(&mMutex);
+
+    if (key == mJobInProgress) { return QImage(); }
+    for (int i = 0; i < mQueue.count(); i++) {
+        if (mQueue[i].key == key) { return QImage(); }
+    }
+
+    Job job;
+    job.key = key;
+    job.filepath = filepath;
+    job.pdfPage = pdfPage;
+    job.refPath = QString("%1/%2.ref").arg(mCacheDir).arg(QString(
+            QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex()));
+    mQueue.append(job);
+    mCondition.wakeAll();
+
+    return QImage();
+}
+
+void ThumbnailCache::cancelPending()
+{
+    QMutexLocker locker(&mMutex);
+    mQueue.clear();
+}
+
+QString ThumbnailCache::thumbnailKey(QString filepath, int pdfPage)
+{
+    QString fileKey = mFileKeys.value(filepath);
+    if (fileKey.isEmpty()) {
+        QFileInfo fi(filepath);
+        fileKey = QString("%1|%2|%3")
+                .arg(fi.canonicalFilePath())
+                .arg(fi.lastModified().toMSecsSinceEpoch())
+                .arg(fi.size());
+        mFileKeys.insert(filepath, fileKey);
+    }
+    return QString("%1|%2|%3x%4")
+            .arg(fileKey)
+            .arg(pdfPage)
+            .arg(thumbnailSize.width())
+            .arg(thumbnailSize.height());
+}
+
+QString ThumbnailCache::readRef(QString refPath)
+{
+    QString name = refContentName(refPath);
+    if (name.isEmpty()) { return QString(); }
+    // Modification time of the reference is its last use, see pruneDiskCache()
+    QFile file(refPath);
+    if (file.open(QIODevice::ReadOnly)) {
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+    return QString("%1/images/%2").arg(mCacheDir).arg(name);
+}
+
+void ThumbnailCache::store(QString refPath, QImage image)
+{
+    if (image.isNull()) { return; }
+
+    // Identical thumbnails (e.g. blank pages) are only stored once. Files are
+    // named after the SHA-1 of the content, as a collision would show the
+    // wrong page.
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QString("%1x%2 %3 ").arg(image.width()).arg(image.height())
+                 .arg((int)image.format()).toUtf8());
+    // Scanline padding is not initialised, so only the pixel bytes are hashed
+    int lineBytes = (image.width() * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); y++) {
+        hash.addData((const char*)image.constScanLine(y), lineBytes);
+    }
+    QString name = QString("%1.png").arg(QString(hash.result().toHex()));
+    QString contentPath = QString("%1/images/%2").arg(mCacheDir).arg(name);
+    if (!QFileInfo::exists(contentPath)) {
+        // Write to a temporary file first so a partial file is never read
+        QString tempPath = contentPath + ".tmp";
+        if (!image.save(tempPath, "PNG")) { return; }
+        if (!QFile::rename(tempPath, contentPath)) {
+            QFile::remove(tempPath);
+            if (!QFileInfo::exists(contentPath)) { return; }
+        }
+    }
+
+    QFile file(refPath);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        file.write(name.toUtf8());
+    }
+}
+
+void ThumbnailCache::pruneDiskCache()
+{
+    // Keep the most recently used references up to the cache size. Image
+    // files are counted once, however many references share them.
+    QDir refDir(mCacheDir);
+    QDir imageDir(mCacheDir + "/images");
+    QSet<QString> kept;
+    qint64 total = 0;
+    QFileInfoList refs = refDir.entryInfoList({"*.ref"}, QDir::Files, QDir::Time);
+    foreach (QFileInfo ref, refs) {
+        QString name = refContentName(ref.filePath());
+        QFileInfo content(imageDir.filePath(name));
+        bool keep = !name.isEmpty() && content.exists();
+        if (keep && !kept.contains(name)) {
+            keep = (total + content.size() <= diskCacheBytes);
+            if (keep) {
+                total += content.size();
+                kept.insert(name);
+            }
+        }
+        if (!keep) {
+            refDir.remove(ref.fileName());
+        }
+    }
+
+    // Remove image files no reference points to, and left over temporary
+    // files of interrupted writes
+    foreach (QString name, imageDir.entryList(QDir::Files)) {
+        if (!kept.contains(name)) {
+            imageDir.remove(name);
+        }
+    }
+}
+
+bool ThumbnailCache::takeJob(Job* job)
+{
+    QMutexLocker locker(&mMutex);
+
+    mJobInProgress.clear();
+    while (mQueue.isEmpty() && !mStop) {
+        mCondition.wait(&mMutex);
+    }
+    if (mStop) { return false; }
+
+    *job = mQueue.takeFirst();
+    mJobInProgress = job->key;
+    return true;
+}
+
+void ThumbnailCache::jobDone(Job job, QImage image)
+{
+    // Called from worker thread. Store the result in the GUI thread.
+    QMetaObject::invokeMethod(this, [=]()
+    {
+        // Failed renders are stored as null images so they are not requested
+        // over and over.
+        int costKb = qMax(1, (int)(image.sizeInBytes() / 1024));
+        mImages.insert(job.key, new QImage(image), costKb);
+        emit thumbnailReady(job.filepath, job.pdfPage);
+    }, Qt::QueuedConnection);
+}
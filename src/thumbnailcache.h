@@ -0,0 +1,103 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* ThumbnailCache
+ *
+ * Low resolution page thumbnails, rendered on a background thread separate
+ * from the full resolution page renders.
+ *
+ * Thumbnails are kept in a memory cache and in a persistent disk cache in the
+ * user cache location. A thumbnail is identified by the PDF file (canonical
+ * path, modification time and size) and the page number, so a changed PDF
+ * gets new thumbnails.
+ *
+ * On disk, each thumbnail has a small reference file named after its key,
+ * which holds the name of the image file in the images directory. Image files
+ * are named after the SHA-1 of their content, so identical thumbnails are
+ * only stored once. When the worker starts, least recently used references
+ * are removed to keep the images within a size limit, along with images that
+ * no reference points to.
+ *
+ * thumbnail() returns immediately. If the thumbnail is not in memory, a null
+ * image is returned and a request is queued. The thumbnailReady() signal is
+ * emitted once it is available. cancelPending() clears the queue so that only
+ * the most recently requested (i.e. visible) thumbnails get rendered.
+ */
+
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QWaitCondition>
+
+class ThumbnailWorker;
+
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThumbnailCache(QObject* parent = nullptr);
+    ~ThumbnailCache();
+
+    // Thumbnails are scaled to fit in this size
+    static const QSize thumbnailSize;
+
+    QImage thumbnail(QString filepath, int pdfPage);
+    void cancelPending();
+
+signals:
+    void thumbnailReady(QString filepath, int pdfPage);
+
+private:
+    friend class ThumbnailWorker;
+
+    struct Job {
+        QString key;
+        QString filepath;
+        int pdfPage = 0;
+        QString refPath;
+    };
+
+    QString thumbnailKey(QString filepath, int pdfPage);
+    QHash<QString, QString> mFileKeys;
+    QCache<QString, QImage> mImages;
+    QString mCacheDir;
+    // Disk cache, used from worker thread
+    QString readRef(QString refPath);
+    void store(QString refPath, QImage image);
+    void pruneDiskCache();
+
+    // Shared with worker thread
+    QMutex mMutex;
+    QWaitCondition mCondition;
+    QList<Job> mQueue;
+    QString mJobInProgress;
+    bool mStop = false;
+    bool takeJob(Job* job);
+    void jobDone(Job job, QImage image);
+
+    ThumbnailWorker* mWorker = nullptr;
+};
+
+#endif // THUMBNAILCACHE_H
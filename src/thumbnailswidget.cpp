@@ -0,0 +1,184 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "thumbnailswidget.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+ThumbnailsWidget::ThumbnailsWidget(QWidget* parent)
+    : QAbstractScrollArea{parent}
+{
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+}
+
+void ThumbnailsWidget::setThumbnailCache(ThumbnailCache* cache)
+{
+    mCache = cache;
+    connect(mCache, &ThumbnailCache::thumbnailReady,
+            this, [=](QString /*filepath*/, int /*pdfPage*/)
+    {
+        if (isVisible()) {
+            viewport()->update();
+        }
+    });
+}
+
+void ThumbnailsWidget::setItems(QList<Item> items)
+{
+    mItems = items;
+    mCurrent = -1;
+    updateScrollBars();
+    viewport()->update();
+}
+
+void ThumbnailsWidget::setCurrent(int index)
+{
+    mCurrent = index;
+    viewport()->update();
+}
+
+void ThumbnailsWidget::scrollToIndex(int index)
+{
+    QRect rect = cellRect(index);
+    int y = rect.top() + verticalScrollBar()->value();
+    verticalScrollBar()->setValue(y - (viewport()->height() - rect.height()) / 2);
+}
+
+void ThumbnailsWidget::paintEvent(QPaintEvent* /*event*/)
+{
+    QPainter painter(viewport());
+    painter.fillRect(viewport()->rect(), palette().window());
+
+    if (mItems.isEmpty()) { return; }
+
+    // Retarget the thumbnail queue to the cells that are visible now
+    if (mCache) { mCache->cancelPending(); }
+
+    QSize cell = cellSize();
+    int cols = columnCount();
+    int firstRow = verticalScrollBar()->value() / cell.height();
+    int lastRow = (verticalScrollBar()->value() + viewport()->height()) / cell.height();
+
+    int first = firstRow * cols;
+    int last = qMin(mItems.count() - 1, (lastRow + 1) * cols - 1);
+
+    for (int i = first; i <= last; i++) {
+        const Item& item = mItems[i];
+        QRect rect = cellRect(i);
+        QRect thumbRect(rect.topLeft(), ThumbnailCache::thumbnailSize);
+
+        QImage image;
+        if (mCache) {
+            image = mCache->thumbnail(item.filepath, item.pdfPage);
+        }
+        if (!image.isNull()) {
+            QSize size = image.size().scaled(thumbRect.size(), Qt::KeepAspectRatio);
+            QRect imageRect(QPoint(), size);
+            imageRect.moveCenter(thumbRect.center());
+            painter.fillRect(imageRect, Qt::white);
+            painter.drawImage(imageRect, image);
+            thumbRect = imageRect;
+        } else {
+            painter.fillRect(thumbRect, Qt::white);
+        }
+
+        if (i == mCurrent) {
+            painter.setPen(QPen(QColor("#2f8ca3"), 4));
+        } else {
+            painter.setPen(QPen(Qt::gray, 1));
+        }
+        painter.drawRect(thumbRect);
+
+        painter.setPen(palette().windowText().color());
+        painter.drawText(QRect(rect.left(), rect.bottom() - labelHeight,
+                               rect.width(), labelHeight),
+                         Qt::AlignCenter, item.label);
+    }
+}
+
+void ThumbnailsWidget::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void ThumbnailsWidget::mousePressEvent(QMouseEvent* event)
+{
+    int index = indexAt(event->pos());
+    if (index >= 0) {
+        emit itemClicked(index);
+    }
+}
+
+void ThumbnailsWidget::scrollContentsBy(int /*dx*/, int /*dy*/)
+{
+    viewport()->update();
+}
+
+QSize ThumbnailsWidget::cellSize()
+{
+    return QSize(ThumbnailCache::thumbnailSize.width() + spacing,
+                 ThumbnailCache::thumbnailSize.height() + labelHeight + spacing);
+}
+
+int ThumbnailsWidget::columnCount()
+{
+    return qMax(1, viewport()->width() / cellSize().width());
+}
+
+int ThumbnailsWidget::rowCount()
+{
+    int cols = columnCount();
+    return (mItems.count() + cols - 1) / cols;
+}
+
+QRect ThumbnailsWidget::cellRect(int index)
+{
+    QSize cell = cellSize();
+    int cols = columnCount();
+    // Center the grid horizontally
+    int xoffset = (viewport()->width() - cols * cell.width() + spacing) / 2;
+    int x = xoffset + (index % cols) * cell.width();
+    int y = (index / cols) * cell.height() + spacing - verticalScrollBar()->value();
+    return QRect(x, y, cell.width() - spacing, cell.height() - spacing);
+}
+
+int ThumbnailsWidget::indexAt(QPoint pos)
+{
+    QSize cell = cellSize();
+    int cols = columnCount();
+    int row = (pos.y() + verticalScrollBar()->value()) / cell.height();
+    int index = row * cols;
+    for (int i = index; (i < index + cols) && (i < mItems.count()); i++) {
+        if (cellRect(i).contains(pos)) { return i; }
+    }
+    return -1;
+}
+
+void ThumbnailsWidget::updateScrollBars()
+{
+    int contentHeight = rowCount() * cellSize().height() + spacing;
+    verticalScrollBar()->setRange(0, qMax(0, contentHeight - viewport()->height()));
+    verticalScrollBar()->setPageStep(viewport()->height());
+    verticalScrollBar()->setSingleStep(cellSize().height() / 4);
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef THUMBNAILSWIDGET_H
+#define THUMBNAILSWIDGET_H
+
+#include "thumbnailcache.h"
+
+#include <QAbstractScrollArea>
+
+// Scrollable grid of page thumbnails. Only the cells in the visible part of the
+// grid are painted and only their thumbnails are requested from the cache, so
+// the item count does not affect scrolling.
+class ThumbnailsWidget : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    explicit ThumbnailsWidget(QWidget* parent = nullptr);
+
+    struct Item {
+        QString filepath;
+        int pdfPage = 0;
+        QString label;
+    };
+
+    void setThumbnailCache(ThumbnailCache* cache);
+    void setItems(QList<Item> items);
+    void setCurrent(int index);
+    void scrollToIndex(int index);
+
+signals:
+    void itemClicked(int index);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    ThumbnailCache* mCache = nullptr;
+    QList<Item> mItems;
+    int mCurrent = -1;
+
+    const int spacing = 12;
+    const int labelHeight = 20;
+
+    QSize cellSize();
+    int columnCount();
+    int rowCount();
+    QRect cellRect(int index);
+    int indexAt(QPoint pos);
+    void updateScrollBars();
+};
+
+#endif // THUMBNAILSWIDGET_H
@@ -0,0 +1,143 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "undostack.h"
+
+UndoStack::UndoStack(QObject* parent)
+    : QObject{parent}
+{
+
+}
+
+void UndoStack::push(QString text, Action undo, Action redo, qint64 bytes)
+{
+    if (mBusy) { return; }
+
+    // Drop commands that could be redone
+    while (mCommands.count() > mIndex) {
+        mBytes -= mCommands.takeLast().bytes;
+    }
+    if (mCleanIndex > mIndex) { mCleanIndex = -1; }
+
+    Command command;
+    command.text = text;
+    command.undo = undo;
+    command.redo = redo;
+    command.bytes = bytes;
+    mCommands.append(command);
+    mBytes += bytes;
+    mIndex++;
+
+    trim();
+    emit changed();
+}
+
+void UndoStack::clear()
+{
+    mCommands.clear();
+    mIndex = 0;
+    mCleanIndex = 0;
+    mBytes = 0;
+    emit changed();
+}
+
+bool UndoStack::canUndo()
+{
+    return mIndex > 0;
+}
+
+bool UndoStack::canRedo()
+{
+    return mIndex < mCommands.count();
+}
+
+QString UndoStack::undoText()
+{
+    if (!canUndo()) { return QString(); }
+    return mCommands[mIndex - 1].text;
+}
+
+QString UndoStack::redoText()
+{
+    if (!canRedo()) { return QString(); }
+    return mCommands[mIndex].text;
+}
+
+void UndoStack::undo()
+{
+    if (!canUndo() || mBusy) { return; }
+
+    mBusy = true;
+    mIndex--;
+    mCommands[mIndex].undo();
+    mBusy = false;
+
+    emit changed();
+}
+
+void UndoStack::redo()
+{
+    if (!canRedo() || mBusy) { return; }
+
+    mBusy = true;
+    mCommands[mIndex].redo();
+    mIndex++;
+    mBusy = false;
+
+    emit changed();
+}
+
+void UndoStack::setClean()
+{
+    mCleanIndex = mIndex;
+    emit changed();
+}
+
+void UndoStack::resetClean()
+{
+    mCleanIndex = -1;
+    emit changed();
+}
+
+bool UndoStack::isClean()
+{
+    return mIndex == mCleanIndex;
+}
+
+void UndoStack::setMemoryLimit(qint64 bytes)
+{
+    mMemoryLimit = bytes;
+    trim();
+}
+
+qint64 UndoStack::memoryUsed()
+{
+    return mBytes;
+}
+
+void UndoStack::trim()
+{
+    // Drop oldest done commands until within the limit
+    while ((mBytes > mMemoryLimit) && (mIndex > 1)) {
+        mBytes -= mCommands.takeFirst().bytes;
+        mIndex--;
+        if (mCleanIndex >= 0) { mCleanIndex--; }
+    }
+}
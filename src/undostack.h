@@ -0,0 +1,94 @@
+/******************************************************************************
+ *
+ * This file is part of SheepMusic.
+ * Copyright (C) 2025 Gideon van der Kolf
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+/* UndoStack
+ *
+ * History of session edits for undo and redo.
+ *
+ * A command is a pair of functions undoing and redoing an edit that has
+ * already been done when it is pushed. Commands capture the objects they
+ * change (e.g. a DrawCurvePtr), so edits share data with the session instead
+ * of copying it.
+ *
+ * The history is limited by the estimated memory kept alive by the commands.
+ * When the limit is exceeded the oldest commands are dropped (the newest one is
+ * always kept).
+ *
+ * The clean state (e.g. the saved session) is set with setClean(). Changes
+ * that are not recorded in the history call resetClean(), after which the
+ * clean state can't be reached with undo/redo anymore.
+ */
+
+#ifndef UNDOSTACK_H
+#define UNDOSTACK_H
+
+#include <QObject>
+
+#include <functional>
+
+class UndoStack : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UndoStack(QObject* parent = nullptr);
+
+    typedef std::function<void()> Action;
+
+    void push(QString text, Action undo, Action redo, qint64 bytes = 0);
+    void clear();
+
+    bool canUndo();
+    bool canRedo();
+    QString undoText();
+    QString redoText();
+    void undo();
+    void redo();
+
+    void setClean();
+    void resetClean();
+    bool isClean();
+
+    void setMemoryLimit(qint64 bytes);
+    qint64 memoryUsed();
+
+signals:
+    void changed();
+
+private:
+    struct Command {
+        QString text;
+        Action undo;
+        Action redo;
+        qint64 bytes = 0;
+    };
+    QList<Command> mCommands;
+    // Commands before this index are done, the rest can be redone
+    int mIndex = 0;
+    // Index at which the stack is clean, -1 if not reachable
+    int mCleanIndex = 0;
+    qint64 mBytes = 0;
+    qint64 mMemoryLimit = 32 * 1024 * 1024;
+    // Set while undoing/redoing, when pushing is not allowed
+    bool mBusy = false;
+
+    void trim();
+};
+
+#endif // UNDOSTACK_H